@@ -0,0 +1,365 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// Drives the mock libraries the way the plugin does each frame (pump the
+// context, read the head and eye poses, present both eyes through
+// RenderManager), on the manual clock, and reports how long each stage took.
+// Runs are deterministic for a given config, so results can be compared
+// across changes.
+
+#include "osvr_mock/MockControlC.h"
+
+#include <osvr/ClientKit/ContextC.h>
+#include <osvr/ClientKit/DisplayC.h>
+#include <osvr/ClientKit/InterfaceC.h>
+#include <osvr/ClientKit/InterfaceCallbackC.h>
+#include <osvr/ClientKit/InterfaceStateC.h>
+#include <osvr/RenderKit/RenderManagerOpenGLC.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    const double FrameSeconds = 1.0 / 90.0;
+    const double ReconnectTimeoutSeconds = 2.0;
+
+    struct Settings
+    {
+        int Frames = 900;
+        const char* Config = nullptr;
+        int KillAtFrame = -1;
+        double RestartAfterSeconds = 1.0;
+    };
+
+    /** Wall-clock durations of one stage, in microseconds. */
+    class Stage
+    {
+    public:
+        explicit Stage(const char* name) : Name(name) {}
+
+        void Add(double micros) { Samples.push_back(micros); }
+
+        void Print()
+        {
+            if (Samples.empty()) {
+                std::printf("%-10s no samples\n", Name);
+                return;
+            }
+            std::sort(Samples.begin(), Samples.end());
+            double sum = 0.0;
+            for (double sample : Samples) {
+                sum += sample;
+            }
+            std::printf("%-10s n=%-6zu mean=%8.2f p50=%8.2f p99=%8.2f max=%8.2f us\n", Name, Samples.size(),
+                sum / Samples.size(), Percentile(0.5), Percentile(0.99), Samples.back());
+        }
+
+    private:
+        double Percentile(double p) const
+        {
+            return Samples[std::min(Samples.size() - 1, static_cast<size_t>(p * Samples.size()))];
+        }
+
+        const char* Name;
+        std::vector<double> Samples;
+    };
+
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Stage& stage) : Target(stage), Start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer()
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - Start;
+            Target.Add(std::chrono::duration<double, std::micro>(elapsed).count());
+        }
+
+    private:
+        Stage& Target;
+        std::chrono::steady_clock::time_point Start;
+    };
+
+    double NowSeconds()
+    {
+        OSVR_TimeValue now;
+        osvrTimeValueGetNow(&now);
+        return now.seconds + now.microseconds / 1000000.0;
+    }
+
+    /** What the plugin holds from one client context. */
+    struct Client
+    {
+        Client() {}
+
+        OSVR_ClientContext Context = nullptr;
+        OSVR_ClientInterface Head = nullptr;
+        OSVR_DisplayConfig Display = nullptr;
+        double LastReportSeconds = 0.0;
+        bool bHasConnected = false;
+        double DisconnectedSeconds = 0.0;
+
+        bool Open()
+        {
+            Context = osvrClientInit("com.osvr.mock.bench");
+            return Context && osvrClientGetInterface(Context, "/me/head", &Head) == OSVR_RETURN_SUCCESS
+                && osvrRegisterPoseCallback(Head, &Client::OnPose, this) == OSVR_RETURN_SUCCESS;
+        }
+
+        ~Client()
+        {
+            if (Display) {
+                osvrClientFreeDisplay(Display);
+            }
+            if (Context) {
+                osvrClientShutdown(Context);
+            }
+        }
+
+        /** Gets the display config once connected. @return True once it has started up. */
+        bool UpdateDisplay()
+        {
+            if (!Display && osvrClientCheckStatus(Context) == OSVR_RETURN_SUCCESS) {
+                osvrClientGetDisplay(Context, &Display);
+            }
+            return Display && osvrClientCheckDisplayStartup(Display) == OSVR_RETURN_SUCCESS;
+        }
+
+        /** Tracks the connection status like the plugin. @return True once it's been down for too long. */
+        bool IsConnectionLost(double now)
+        {
+            if (osvrClientCheckStatus(Context) == OSVR_RETURN_SUCCESS) {
+                bHasConnected = true;
+                DisconnectedSeconds = 0.0;
+            } else if (bHasConnected && DisconnectedSeconds == 0.0) {
+                DisconnectedSeconds = now;
+            }
+            return DisconnectedSeconds > 0.0 && now - DisconnectedSeconds > ReconnectTimeoutSeconds;
+        }
+
+        static void OnPose(void* userdata, const OSVR_TimeValue* timestamp, const OSVR_PoseReport*)
+        {
+            static_cast<Client*>(userdata)->LastReportSeconds = timestamp->seconds + timestamp->microseconds / 1000000.0;
+        }
+    };
+
+    /**
+    * RenderManager and the two eye buffers, recreated after a failure like the
+    * plugin's custom present. Like the plugin, it hands RenderManager the head
+    * pose, so RenderManager never pumps the client context.
+    */
+    struct Present
+    {
+        OSVR_RenderManager RenderManager = nullptr;
+        OSVR_RenderManagerOpenGL RenderManagerOpenGL = nullptr;
+        OSVR_RenderBufferOpenGL Buffers[2];
+
+        bool Open(OSVR_ClientContext context)
+        {
+            OSVR_GraphicsLibraryOpenGL library;
+            std::memset(&library, 0, sizeof(library));
+            if (osvrCreateRenderManagerOpenGL(context, "OpenGL", library, &RenderManager, &RenderManagerOpenGL) != OSVR_RETURN_SUCCESS) {
+                return false;
+            }
+            OSVR_OpenResultsOpenGL results;
+            if (osvrRenderManagerOpenDisplayOpenGL(RenderManagerOpenGL, &results) != OSVR_RETURN_SUCCESS
+                || results.status == OSVR_OPEN_STATUS_FAILURE) {
+                Close();
+                return false;
+            }
+            OSVR_RenderManagerRegisterBufferState state;
+            osvrRenderManagerStartRegisterRenderBuffers(&state);
+            for (GLuint eye = 0; eye < 2; eye++) {
+                Buffers[eye].colorBufferName = eye + 1;
+                Buffers[eye].depthStencilBufferName = 0;
+                osvrRenderManagerRegisterRenderBufferOpenGL(state, Buffers[eye]);
+            }
+            if (osvrRenderManagerFinishRegisterRenderBuffers(RenderManager, state, OSVR_FALSE) != OSVR_RETURN_SUCCESS) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        void Close()
+        {
+            if (RenderManager) {
+                osvrDestroyRenderManager(RenderManager);
+            }
+            RenderManager = nullptr;
+            RenderManagerOpenGL = nullptr;
+        }
+
+        bool Frame(OSVR_PoseState head)
+        {
+            OSVR_RenderParams params;
+            osvrRenderManagerGetDefaultRenderParams(&params);
+            params.roomFromHeadReplace = &head;
+            OSVR_RenderInfoOpenGL infos[2];
+            for (OSVR_RenderInfoCount eye = 0; eye < 2; eye++) {
+                if (osvrRenderManagerGetRenderInfoOpenGL(RenderManagerOpenGL, eye, params, &infos[eye]) != OSVR_RETURN_SUCCESS) {
+                    return false;
+                }
+            }
+            OSVR_RenderManagerPresentState state;
+            osvrRenderManagerStartPresentRenderBuffers(&state);
+            const OSVR_ViewportDescription fullViewport = { 0.0, 0.0, 1.0, 1.0 };
+            for (int eye = 0; eye < 2; eye++) {
+                osvrRenderManagerPresentRenderBufferOpenGL(state, Buffers[eye], infos[eye], fullViewport);
+            }
+            return osvrRenderManagerFinishPresentRenderBuffers(RenderManager, state, params, OSVR_FALSE) == OSVR_RETURN_SUCCESS
+                && osvrRenderManagerGetDoingOkay(RenderManager) == OSVR_RETURN_SUCCESS;
+        }
+    };
+
+    bool ParseArguments(int argc, char* argv[], Settings& settings)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            const bool bHasValue = i + 1 < argc;
+            if (arg == "--frames" && bHasValue) {
+                settings.Frames = std::atoi(argv[++i]);
+            } else if (arg == "--config" && bHasValue) {
+                settings.Config = argv[++i];
+            } else if (arg == "--kill-at-frame" && bHasValue) {
+                settings.KillAtFrame = std::atoi(argv[++i]);
+            } else if (arg == "--restart-after" && bHasValue) {
+                settings.RestartAfterSeconds = std::atof(argv[++i]);
+            } else {
+                return false;
+            }
+        }
+        return settings.Frames > 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    if (!ParseArguments(argc, argv, settings)) {
+        std::fprintf(stderr, "usage: %s [--frames N] [--config FILE] [--kill-at-frame N] [--restart-after SECONDS]\n", argv[0]);
+        return 2;
+    }
+
+    osvrMockUseManualClock(1);
+    if (settings.Config && osvrMockLoadConfig(settings.Config) != 0) {
+        std::fprintf(stderr, "couldn't load %s\n", settings.Config);
+        return 1;
+    }
+
+    Stage update("update"), poses("poses"), present("present"), reconnect("reconnect");
+    std::unique_ptr<Client> client(new Client()), pendingClient;
+    Present renderer;
+    int framesPresented = 0, framesWithoutPose = 0;
+    double killSeconds = 0.0;
+    // the last head pose read, which frames are presented with; identity until then
+    OSVR_PoseState head;
+    std::memset(&head, 0, sizeof(head));
+    head.rotation.data[0] = 1.0;
+
+    if (!client->Open()) {
+        std::fprintf(stderr, "couldn't create a client context\n");
+        return 1;
+    }
+
+    for (int frame = 0; frame < settings.Frames; frame++) {
+        if (frame == settings.KillAtFrame) {
+            osvrMockKillServer(settings.RestartAfterSeconds);
+            killSeconds = NowSeconds();
+        }
+
+        {
+            ScopedTimer timer(update);
+            osvrClientUpdate(client->Context);
+        }
+
+        // reconnect the way the plugin does: a new context once the connection is lost, swapped in when it's up
+        if (client->IsConnectionLost(NowSeconds()) && !pendingClient) {
+            pendingClient.reset(new Client());
+            if (!pendingClient->Open()) {
+                pendingClient.reset();
+            }
+        }
+        if (pendingClient) {
+            osvrClientUpdate(pendingClient->Context);
+            if (pendingClient->UpdateDisplay() && pendingClient->LastReportSeconds > 0.0) {
+                renderer.Close();
+                client = std::move(pendingClient);
+                if (killSeconds > 0.0) {
+                    reconnect.Add((NowSeconds() - killSeconds) * 1000000.0);
+                    killSeconds = 0.0;
+                }
+            }
+        }
+
+        const bool bDisplayUp = client->UpdateDisplay();
+        {
+            ScopedTimer timer(poses);
+            OSVR_TimeValue timestamp;
+            OSVR_Pose3 eye;
+            if (osvrGetPoseState(client->Head, &timestamp, &head) != OSVR_RETURN_SUCCESS
+                || !bDisplayUp
+                || osvrClientGetViewerEyePose(client->Display, 0, 0, &eye) != OSVR_RETURN_SUCCESS
+                || osvrClientGetViewerEyePose(client->Display, 0, 1, &eye) != OSVR_RETURN_SUCCESS) {
+                framesWithoutPose++;
+            }
+        }
+
+        if (bDisplayUp) {
+            if (!renderer.RenderManager) {
+                renderer.Open(client->Context);
+            }
+            if (renderer.RenderManager) {
+                ScopedTimer timer(present);
+                if (renderer.Frame(head)) {
+                    framesPresented++;
+                } else {
+                    renderer.Close();
+                }
+            }
+        }
+
+        osvrMockAdvanceClock(FrameSeconds);
+    }
+
+    renderer.Close();
+    client.reset();
+    pendingClient.reset();
+
+    std::printf("%d frames at 90 Hz, %d presented, %d without a pose\n", settings.Frames, framesPresented, framesWithoutPose);
+    update.Print();
+    poses.Print();
+    present.Print();
+    if (settings.KillAtFrame >= 0) {
+        reconnect.Print();
+    }
+
+    OSVRMockStats stats;
+    osvrMockGetStats(&stats);
+    std::printf("contexts: %u created, %u connected; updates: %llu; reports: %llu delivered, %llu dropped\n",
+        stats.contextsCreated, stats.contextsConnected, static_cast<unsigned long long>(stats.updates),
+        static_cast<unsigned long long>(stats.reportsDelivered), static_cast<unsigned long long>(stats.reportsDropped));
+    std::printf("RenderManager: %u opened, %u open failures, %llu buffers registered, %llu presented, %llu present failures\n",
+        stats.displaysOpened, stats.displayOpenFailures, static_cast<unsigned long long>(stats.buffersRegistered),
+        static_cast<unsigned long long>(stats.framesPresented), static_cast<unsigned long long>(stats.presentFailures));
+    return 0;
+}
@@ -0,0 +1,83 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+/*
+* Control API of the mock OSVR libraries. The mock implements the parts of
+* the ClientKit and RenderManager (OpenGL) C APIs the plugin uses, against a
+* simulated server instead of a real one; these calls set that server up and
+* read back what happened. They are exported from the mock osvrClientKit.
+*
+* Everything is configured by options (see Documentation.md), read from the
+* file in the OSVR_MOCK_CONFIG environment variable when the first context
+* is created, and changeable at any time with osvrMockSetOption.
+*/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OSVRMockStats {
+    /** Client contexts created, and how many of them connected */
+    uint32_t contextsCreated;
+    uint32_t contextsConnected;
+    /** osvrClientUpdate calls */
+    uint64_t updates;
+    /** Reports handed to interfaces, and reports lost to osvr_mock drop_rate */
+    uint64_t reportsDelivered;
+    uint64_t reportsDropped;
+    /** RenderManager display opens that succeeded and that were failed on purpose */
+    uint32_t displaysOpened;
+    uint32_t displayOpenFailures;
+    uint64_t buffersRegistered;
+    uint64_t framesPresented;
+    uint64_t presentFailures;
+} OSVRMockStats;
+
+/** Reads options from a file of "key = value" lines. @return 0 on success. */
+int osvrMockLoadConfig(const char *path);
+
+/** Sets one option. @return 0 on success, -1 for an unknown key or a bad value. */
+int osvrMockSetOption(const char *key, const char *value);
+
+/** Restores the default options, clears the stats and restarts the clock and the server. */
+void osvrMockReset(void);
+
+/**
+* Switches between the system clock and a manual one that only moves with
+* osvrMockAdvanceClock, for deterministic runs. Reports are generated from
+* the clock, so with the manual clock every run sees the same reports.
+*/
+void osvrMockUseManualClock(int enabled);
+void osvrMockAdvanceClock(double seconds);
+
+/**
+* Takes the server down now, as if it crashed or was restarted, and brings it
+* back after restartSeconds (never if negative). Existing contexts stay
+* "connected" but get no more reports, like with the real ClientKit; new
+* contexts connect once it's back.
+*/
+void osvrMockKillServer(double restartSeconds);
+
+void osvrMockGetStats(OSVRMockStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
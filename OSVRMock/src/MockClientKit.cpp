@@ -0,0 +1,356 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "MockContext.h"
+#include "MockClock.h"
+#include "MockServer.h"
+
+#include <osvr/ClientKit/InterfaceC.h>
+#include <osvr/ClientKit/InterfaceStateC.h>
+#include <osvr/ClientKit/ParametersC.h>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+using osvrmock::Server;
+
+namespace {
+    std::mutex gContextsMutex;
+    std::set<OSVR_ClientContext> gContexts;
+
+    OSVR_ClientInterfaceObject::Kind KindForPath(const std::string& path)
+    {
+        if (path.compare(0, 12, "/controller/") != 0) {
+            return OSVR_ClientInterfaceObject::Pose;
+        }
+        const size_t last = path.rfind('/');
+        const std::string leaf = path.substr(last + 1);
+        if (leaf == "trigger" || leaf == "x" || leaf == "y") {
+            return OSVR_ClientInterfaceObject::Analog;
+        }
+        return OSVR_ClientInterfaceObject::Button;
+    }
+
+    /** One report for one interface, gathered under the server mutex and delivered after. */
+    struct PendingReport
+    {
+        OSVR_ClientInterfaceObject* Interface;
+        int64_t Micros;
+        OSVR_PoseState Pose;
+        OSVR_ButtonState Button;
+        OSVR_AnalogState Analog;
+    };
+
+    void MakeReport(const Server& server, OSVR_ClientInterfaceObject* iface, int64_t micros, std::vector<PendingReport>& out)
+    {
+        PendingReport report;
+        std::memset(&report, 0, sizeof(report));
+        report.Interface = iface;
+        report.Micros = micros;
+        switch (iface->ReportKind) {
+        case OSVR_ClientInterfaceObject::Pose:
+            report.Pose = server.GetPathPose(iface->Path, micros);
+            break;
+        case OSVR_ClientInterfaceObject::Button:
+            report.Button = server.GetButtonState(iface->Path, micros);
+            break;
+        case OSVR_ClientInterfaceObject::Analog:
+            report.Analog = server.GetAnalogState(iface->Path, micros);
+            break;
+        }
+        out.push_back(report);
+    }
+
+    void Deliver(const PendingReport& pending)
+    {
+        OSVR_ClientInterfaceObject* iface = pending.Interface;
+        const OSVR_TimeValue timestamp = osvrmock::ToTimeValue(pending.Micros);
+        iface->bHasState = true;
+        iface->Timestamp = timestamp;
+        switch (iface->ReportKind) {
+        case OSVR_ClientInterfaceObject::Pose: {
+            iface->PoseState = pending.Pose;
+            OSVR_PoseReport report = { 0, pending.Pose };
+            for (auto& callback : iface->PoseCallbacks) {
+                callback.first(callback.second, &timestamp, &report);
+            }
+            break;
+        }
+        case OSVR_ClientInterfaceObject::Button: {
+            iface->ButtonState = pending.Button;
+            OSVR_ButtonReport report = { 0, pending.Button };
+            for (auto& callback : iface->ButtonCallbacks) {
+                callback.first(callback.second, &timestamp, &report);
+            }
+            break;
+        }
+        case OSVR_ClientInterfaceObject::Analog: {
+            iface->AnalogState = pending.Analog;
+            OSVR_AnalogReport report = { 0, pending.Analog };
+            for (auto& callback : iface->AnalogCallbacks) {
+                callback.first(callback.second, &timestamp, &report);
+            }
+            break;
+        }
+        }
+    }
+
+    OSVR_ClientInterfaceObject* FindInterface(OSVR_ClientContext ctx, OSVR_ClientInterface iface)
+    {
+        for (auto& held : ctx->Interfaces) {
+            if (held.get() == iface) {
+                return held.get();
+            }
+        }
+        return nullptr;
+    }
+}
+
+OSVR_ClientInterfaceObject::OSVR_ClientInterfaceObject(OSVR_ClientContext context, const std::string& path)
+    : Context(context), Path(path), ReportKind(KindForPath(path))
+{
+    std::memset(&Timestamp, 0, sizeof(Timestamp));
+    std::memset(&PoseState, 0, sizeof(PoseState));
+    PoseState.rotation.data[0] = 1.0;
+}
+
+OSVR_ClientContextObject::OSVR_ClientContextObject(const std::string& appId)
+    : AppId(appId), CreatedMicros(osvrMockClockNowMicros()), Viewer(this, "/me/head")
+{
+}
+
+namespace osvrmock {
+
+bool IsLiveContext(OSVR_ClientContext context)
+{
+    std::lock_guard<std::mutex> lock(gContextsMutex);
+    return context && gContexts.count(context) != 0;
+}
+
+} // namespace osvrmock
+
+OSVR_ClientContext osvrClientInit(const char applicationIdentifier[], uint32_t /*flags*/)
+{
+    Server& server = Server::Get();
+    OSVR_ClientContext ctx = new OSVR_ClientContextObject(applicationIdentifier ? applicationIdentifier : "");
+    {
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        server.LoadEnvironmentConfigOnce();
+        OSVRMockStats& stats = server.GetStats();
+        ctx->DropRandom.seed(server.GetOptions().seed + stats.contextsCreated);
+        stats.contextsCreated++;
+    }
+    std::lock_guard<std::mutex> lock(gContextsMutex);
+    gContexts.insert(ctx);
+    return ctx;
+}
+
+OSVR_ReturnCode osvrClientUpdate(OSVR_ClientContext ctx)
+{
+    if (!osvrmock::IsLiveContext(ctx)) {
+        return OSVR_RETURN_FAILURE;
+    }
+
+    std::vector<PendingReport> reports;
+    {
+        Server& server = Server::Get();
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        const osvrmock::Options& opts = server.GetOptions();
+        const int64_t now = osvrMockClockNowMicros();
+        server.Poll(now);
+        OSVRMockStats& stats = server.GetStats();
+        stats.updates++;
+
+        const int64_t start = server.GetStartMicros();
+        const int64_t period = server.GetReportPeriodMicros();
+        const int64_t newest = now - osvrmock::ToMicros(opts.latencySeconds);
+        auto gridAfter = [start, period](int64_t micros) {
+            return micros <= start ? start : start + ((micros - start + period - 1) / period) * period;
+        };
+
+        if (!ctx->bConnected && !ctx->bLost && server.IsUp()
+            && now >= ctx->CreatedMicros + osvrmock::ToMicros(opts.connectDelaySeconds)) {
+            ctx->bConnected = true;
+            ctx->Generation = server.GetGeneration();
+            // like a real server, only reports sent from now on arrive
+            ctx->NextReportMicros = gridAfter(now);
+            stats.contextsConnected++;
+        }
+
+        if (ctx->bConnected) {
+            // don't replay more than a second of backlog after a long stall
+            int64_t micros = gridAfter(std::max(ctx->NextReportMicros, newest - osvrmock::MicrosPerSecond));
+            std::uniform_real_distribution<double> drop(0.0, 1.0);
+            for (; micros <= newest; micros += period) {
+                if (!server.IsReportLive(ctx->Generation, micros)) {
+                    continue;
+                }
+                if (opts.dropRate > 0.0 && drop(ctx->DropRandom) < opts.dropRate) {
+                    stats.reportsDropped++;
+                    continue;
+                }
+                MakeReport(server, &ctx->Viewer, micros, reports);
+                for (auto& iface : ctx->Interfaces) {
+                    MakeReport(server, iface.get(), micros, reports);
+                }
+            }
+            ctx->NextReportMicros = std::max(ctx->NextReportMicros, micros);
+            stats.reportsDelivered += reports.size();
+
+            // the connection drops with the server, after the reports it sent before
+            if (!server.IsUp() || server.GetGeneration() != ctx->Generation) {
+                ctx->bConnected = false;
+                ctx->bLost = true;
+            }
+        }
+    }
+
+    // callbacks may call back into ClientKit, so they run without the server mutex
+    for (const PendingReport& report : reports) {
+        Deliver(report);
+    }
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientCheckStatus(OSVR_ClientContext ctx)
+{
+    return osvrmock::IsLiveContext(ctx) && ctx->bConnected ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrClientShutdown(OSVR_ClientContext ctx)
+{
+    {
+        std::lock_guard<std::mutex> lock(gContextsMutex);
+        if (!ctx || gContexts.erase(ctx) == 0) {
+            return OSVR_RETURN_FAILURE;
+        }
+    }
+    delete ctx;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetInterface(OSVR_ClientContext ctx, const char path[], OSVR_ClientInterface *iface)
+{
+    if (!osvrmock::IsLiveContext(ctx) || !path || !iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    ctx->Interfaces.emplace_back(new OSVR_ClientInterfaceObject(ctx, path));
+    *iface = ctx->Interfaces.back().get();
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientFreeInterface(OSVR_ClientContext ctx, OSVR_ClientInterface iface)
+{
+    if (!osvrmock::IsLiveContext(ctx)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    auto held = std::find_if(ctx->Interfaces.begin(), ctx->Interfaces.end(),
+        [iface](const std::unique_ptr<OSVR_ClientInterfaceObject>& i) { return i.get() == iface; });
+    if (held == ctx->Interfaces.end()) {
+        return OSVR_RETURN_FAILURE;
+    }
+    ctx->Interfaces.erase(held);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterPoseCallback(OSVR_ClientInterface iface, OSVR_PoseCallback cb, void *userdata)
+{
+    if (!iface || !cb || !FindInterface(iface->Context, iface)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->PoseCallbacks.push_back(std::make_pair(cb, userdata));
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterButtonCallback(OSVR_ClientInterface iface, OSVR_ButtonCallback cb, void *userdata)
+{
+    if (!iface || !cb || !FindInterface(iface->Context, iface)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->ButtonCallbacks.push_back(std::make_pair(cb, userdata));
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterAnalogCallback(OSVR_ClientInterface iface, OSVR_AnalogCallback cb, void *userdata)
+{
+    if (!iface || !cb || !FindInterface(iface->Context, iface)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->AnalogCallbacks.push_back(std::make_pair(cb, userdata));
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrGetPoseState(OSVR_ClientInterface iface, struct OSVR_TimeValue *timestamp, OSVR_PoseState *state)
+{
+    if (!iface || iface->ReportKind != OSVR_ClientInterfaceObject::Pose || !iface->bHasState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *timestamp = iface->Timestamp;
+    *state = iface->PoseState;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrGetButtonState(OSVR_ClientInterface iface, struct OSVR_TimeValue *timestamp, OSVR_ButtonState *state)
+{
+    if (!iface || iface->ReportKind != OSVR_ClientInterfaceObject::Button || !iface->bHasState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *timestamp = iface->Timestamp;
+    *state = iface->ButtonState;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrGetAnalogState(OSVR_ClientInterface iface, struct OSVR_TimeValue *timestamp, OSVR_AnalogState *state)
+{
+    if (!iface || iface->ReportKind != OSVR_ClientInterfaceObject::Analog || !iface->bHasState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *timestamp = iface->Timestamp;
+    *state = iface->AnalogState;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetStringParameterLength(OSVR_ClientContext ctx, const char path[], size_t *len)
+{
+    if (!osvrmock::IsLiveContext(ctx) || !path || !len) {
+        return OSVR_RETURN_FAILURE;
+    }
+    if (!ctx->bConnected || std::strcmp(path, "/display") != 0) {
+        *len = 0;
+        return OSVR_RETURN_SUCCESS;
+    }
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    *len = server.GetDisplayDescriptor().size() + 1;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetStringParameter(OSVR_ClientContext ctx, const char path[], char *buf, size_t len)
+{
+    if (!osvrmock::IsLiveContext(ctx) || !path || !buf || !ctx->bConnected || std::strcmp(path, "/display") != 0) {
+        return OSVR_RETURN_FAILURE;
+    }
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    const std::string descriptor = server.GetDisplayDescriptor();
+    if (len < descriptor.size() + 1) {
+        return OSVR_RETURN_FAILURE;
+    }
+    std::memcpy(buf, descriptor.c_str(), descriptor.size() + 1);
+    return OSVR_RETURN_SUCCESS;
+}
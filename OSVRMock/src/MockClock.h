@@ -0,0 +1,53 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include <osvr/Util/TimeValueC.h>
+
+#include <stdint.h>
+
+/*
+* The clock behind osvrTimeValueGetNow, in the mock osvrUtil so that every
+* mock library (and the plugin) sees the same time. Microseconds since the
+* epoch, either from the system clock or from a manual one.
+*/
+extern "C" {
+int64_t osvrMockClockNowMicros(void);
+void osvrMockClockSetManual(int enabled);
+int osvrMockClockIsManual(void);
+void osvrMockClockAdvanceMicros(int64_t micros);
+}
+
+namespace osvrmock {
+
+const int64_t MicrosPerSecond = 1000000;
+
+inline OSVR_TimeValue ToTimeValue(int64_t micros)
+{
+    OSVR_TimeValue tv;
+    tv.seconds = micros / MicrosPerSecond;
+    tv.microseconds = static_cast<OSVR_TimeValue_Microseconds>(micros % MicrosPerSecond);
+    return tv;
+}
+
+inline int64_t ToMicros(double seconds)
+{
+    return static_cast<int64_t>(seconds * MicrosPerSecond + (seconds < 0.0 ? -0.5 : 0.5));
+}
+
+} // namespace osvrmock
@@ -0,0 +1,97 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include <osvr/ClientKit/ContextC.h>
+#include <osvr/ClientKit/InterfaceCallbackC.h>
+#include <osvr/Util/ClientReportTypesC.h>
+#include <osvr/Util/TimeValueC.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+* What the mock's opaque handles point to. Like with the real ClientKit, a
+* context and everything obtained from it may only be used by one thread at
+* a time; the plugin already serializes that with its context mutex.
+*/
+
+struct OSVR_ClientInterfaceObject
+{
+    enum Kind
+    {
+        Pose,
+        Button,
+        Analog
+    };
+
+    OSVR_ClientInterfaceObject(OSVR_ClientContext context, const std::string& path);
+
+    OSVR_ClientContext Context;
+    std::string Path;
+    Kind ReportKind;
+
+    bool bHasState = false;
+    OSVR_TimeValue Timestamp;
+    OSVR_PoseState PoseState;
+    OSVR_ButtonState ButtonState = 0;
+    OSVR_AnalogState AnalogState = 0.0;
+
+    std::vector<std::pair<OSVR_PoseCallback, void*> > PoseCallbacks;
+    std::vector<std::pair<OSVR_ButtonCallback, void*> > ButtonCallbacks;
+    std::vector<std::pair<OSVR_AnalogCallback, void*> > AnalogCallbacks;
+};
+
+struct OSVR_ClientContextObject
+{
+    explicit OSVR_ClientContextObject(const std::string& appId);
+
+    std::string AppId;
+    int64_t CreatedMicros;
+
+    bool bConnected = false;
+    /** Set once the server it connected to went down; like ClientKit, it doesn't connect again. */
+    bool bLost = false;
+    /** Server generation the context connected to; it gets no reports from any other. */
+    uint32_t Generation = 0;
+    /** Time of the next report to deliver, on the server's report grid */
+    int64_t NextReportMicros = 0;
+    std::mt19937 DropRandom;
+
+    std::vector<std::unique_ptr<OSVR_ClientInterfaceObject> > Interfaces;
+    /** The display's viewer pose, kept up to date like any other interface. */
+    OSVR_ClientInterfaceObject Viewer;
+    /** Display configs obtained from the context and not freed yet */
+    int NumDisplays = 0;
+};
+
+namespace osvrmock {
+
+/** @return True if Context is a context the mock created and hasn't shut down. */
+bool IsLiveContext(OSVR_ClientContext context);
+
+/** Eye pose from the viewer pose, for eye 0 (left) or 1 (right). Takes the server mutex. */
+OSVR_Pose3 GetEyePose(const OSVR_Pose3& viewerPose, int eye);
+
+/** Unit-distance clipping planes of the eyes, from the display options. Takes the server mutex. */
+void GetClippingPlanes(double& left, double& right, double& bottom, double& top);
+
+} // namespace osvrmock
@@ -0,0 +1,211 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "MockContext.h"
+#include "MockClock.h"
+#include "MockServer.h"
+
+#include <osvr/ClientKit/DisplayC.h>
+
+#include <cmath>
+
+using osvrmock::Server;
+
+/** One side-by-side display input, one viewer with two eyes, one surface per eye. */
+struct OSVR_DisplayConfigObject
+{
+    explicit OSVR_DisplayConfigObject(OSVR_ClientContext context)
+        : Context(context), CreatedMicros(osvrMockClockNowMicros())
+    {
+    }
+
+    OSVR_ClientContext Context;
+    int64_t CreatedMicros;
+};
+
+namespace {
+    const double Pi = 3.14159265358979323846;
+
+    bool IsStartedUp(OSVR_DisplayConfig disp)
+    {
+        if (!disp || !osvrmock::IsLiveContext(disp->Context) || !disp->Context->Viewer.bHasState) {
+            return false;
+        }
+        Server& server = Server::Get();
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        return osvrMockClockNowMicros() >= disp->CreatedMicros + osvrmock::ToMicros(server.GetOptions().displayStartupDelaySeconds);
+    }
+
+    bool IsValid(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer)
+    {
+        return disp && osvrmock::IsLiveContext(disp->Context) && viewer == 0;
+    }
+
+    bool IsValid(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_EyeCount eye)
+    {
+        return IsValid(disp, viewer) && eye < 2;
+    }
+
+    bool IsValid(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_EyeCount eye, OSVR_SurfaceCount surface)
+    {
+        return IsValid(disp, viewer, eye) && surface == 0;
+    }
+}
+
+namespace osvrmock {
+
+OSVR_Pose3 GetEyePose(const OSVR_Pose3& viewerPose, int eye)
+{
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    const double halfIpd = server.GetOptions().ipdMeters / 2.0;
+    return OffsetPose(viewerPose, eye == 0 ? -halfIpd : halfIpd, 0.0, 0.0);
+}
+
+void GetClippingPlanes(double& left, double& right, double& bottom, double& top)
+{
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    const Options& opts = server.GetOptions();
+    right = std::tan(opts.fovHorizontalDegrees * Pi / 360.0);
+    left = -right;
+    top = std::tan(opts.fovVerticalDegrees * Pi / 360.0);
+    bottom = -top;
+}
+
+} // namespace osvrmock
+
+OSVR_ReturnCode osvrClientGetDisplay(OSVR_ClientContext ctx, OSVR_DisplayConfig *disp)
+{
+    if (!osvrmock::IsLiveContext(ctx) || !disp || !ctx->bConnected) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *disp = new OSVR_DisplayConfigObject(ctx);
+    ctx->NumDisplays++;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientFreeDisplay(OSVR_DisplayConfig disp)
+{
+    if (!disp) {
+        return OSVR_RETURN_FAILURE;
+    }
+    if (osvrmock::IsLiveContext(disp->Context)) {
+        disp->Context->NumDisplays--;
+    }
+    delete disp;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientCheckDisplayStartup(OSVR_DisplayConfig disp)
+{
+    return IsStartedUp(disp) ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrClientGetNumDisplayInputs(OSVR_DisplayConfig disp, OSVR_DisplayInputCount *numDisplayInputs)
+{
+    if (!IsValid(disp, 0)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *numDisplayInputs = 1;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetDisplayDimensions(OSVR_DisplayConfig disp, OSVR_DisplayInputCount displayInputIndex,
+    OSVR_DisplayDimension *width, OSVR_DisplayDimension *height)
+{
+    if (!IsValid(disp, 0) || displayInputIndex != 0) {
+        return OSVR_RETURN_FAILURE;
+    }
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    *width = server.GetOptions().eyeWidth * 2;
+    *height = server.GetOptions().eyeHeight;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetNumViewers(OSVR_DisplayConfig disp, OSVR_ViewerCount *viewers)
+{
+    if (!IsValid(disp, 0)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *viewers = 1;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetViewerPose(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_Pose3 *pose)
+{
+    if (!IsValid(disp, viewer) || !disp->Context->Viewer.bHasState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *pose = disp->Context->Viewer.PoseState;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetNumEyesForViewer(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_EyeCount *eyes)
+{
+    if (!IsValid(disp, viewer)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *eyes = 2;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetViewerEyePose(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_EyeCount eye, OSVR_Pose3 *pose)
+{
+    if (!IsValid(disp, viewer, eye) || !disp->Context->Viewer.bHasState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *pose = osvrmock::GetEyePose(disp->Context->Viewer.PoseState, eye);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetNumSurfacesForViewerEye(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer, OSVR_EyeCount eye,
+    OSVR_SurfaceCount *surfaces)
+{
+    if (!IsValid(disp, viewer, eye)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *surfaces = 1;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetRelativeViewportForViewerEyeSurface(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer,
+    OSVR_EyeCount eye, OSVR_SurfaceCount surface, OSVR_ViewportDimension *left, OSVR_ViewportDimension *bottom,
+    OSVR_ViewportDimension *width, OSVR_ViewportDimension *height)
+{
+    if (!IsValid(disp, viewer, eye, surface)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    *width = server.GetOptions().eyeWidth;
+    *height = server.GetOptions().eyeHeight;
+    *left = eye == 0 ? 0 : *width;
+    *bottom = 0;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetViewerEyeSurfaceProjectionClippingPlanes(OSVR_DisplayConfig disp, OSVR_ViewerCount viewer,
+    OSVR_EyeCount eye, OSVR_SurfaceCount surface, double *left, double *right, double *bottom, double *top)
+{
+    if (!IsValid(disp, viewer, eye, surface)) {
+        return OSVR_RETURN_FAILURE;
+    }
+    osvrmock::GetClippingPlanes(*left, *right, *bottom, *top);
+    return OSVR_RETURN_SUCCESS;
+}
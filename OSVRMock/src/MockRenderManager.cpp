@@ -0,0 +1,318 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "MockContext.h"
+#include "MockClock.h"
+#include "MockServer.h"
+
+#include <osvr/RenderKit/RenderManagerOpenGLC.h>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+using osvrmock::Server;
+
+/*
+* RenderManager, OpenGL flavour, without OpenGL: buffers are just names, and
+* presenting checks what it's given and counts it. D3D11 is Windows-only, so
+* the plugin's D3D11 present can't be run against this.
+*/
+
+namespace {
+    struct RenderManager
+    {
+        OSVR_ClientContext Context;
+        bool bDisplayOpen = false;
+        bool bDoingOkay = true;
+        std::vector<OSVR_RenderBufferOpenGL> Registered;
+        uint64_t NumPresents = 0;
+    };
+
+    struct BufferState
+    {
+        std::vector<OSVR_RenderBufferOpenGL> Buffers;
+    };
+
+    /** Both the generic and the OpenGL handle point to the same object. */
+    template <typename Handle>
+    RenderManager* FromHandle(Handle handle)
+    {
+        return reinterpret_cast<RenderManager*>(handle);
+    }
+
+    BufferState* FromState(void* state)
+    {
+        return reinterpret_cast<BufferState*>(state);
+    }
+
+    bool IsUsable(RenderManager* rm)
+    {
+        return rm && osvrmock::IsLiveContext(rm->Context);
+    }
+}
+
+OSVR_ReturnCode osvrCreateRenderManagerOpenGL(OSVR_ClientContext clientContext, const char graphicsLibraryName[],
+    OSVR_GraphicsLibraryOpenGL /*graphicsLibrary*/, OSVR_RenderManager* renderManagerOut,
+    OSVR_RenderManagerOpenGL* renderManagerOpenGLOut)
+{
+    if (!osvrmock::IsLiveContext(clientContext) || !graphicsLibraryName || std::strcmp(graphicsLibraryName, "OpenGL") != 0
+        || !renderManagerOut || !renderManagerOpenGLOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    RenderManager* rm = new RenderManager();
+    rm->Context = clientContext;
+    *renderManagerOut = reinterpret_cast<OSVR_RenderManager>(rm);
+    *renderManagerOpenGLOut = reinterpret_cast<OSVR_RenderManagerOpenGL>(rm);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrDestroyRenderManager(OSVR_RenderManager renderManager)
+{
+    if (!renderManager) {
+        return OSVR_RETURN_FAILURE;
+    }
+    delete FromHandle(renderManager);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerOpenDisplayOpenGL(OSVR_RenderManagerOpenGL renderManager, OSVR_OpenResultsOpenGL* openResultsOut)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    if (!IsUsable(rm) || !openResultsOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    if (server.TakeOpenFailure() || !rm->Context->bConnected) {
+        server.GetStats().displayOpenFailures++;
+        openResultsOut->status = OSVR_OPEN_STATUS_FAILURE;
+        return OSVR_RETURN_FAILURE;
+    }
+    rm->bDisplayOpen = true;
+    rm->bDoingOkay = true;
+    server.GetStats().displaysOpened++;
+    openResultsOut->status = OSVR_OPEN_STATUS_COMPLETE;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetDoingOkay(OSVR_RenderManager renderManager)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    return IsUsable(rm) && rm->bDoingOkay ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetTimingInfo(OSVR_RenderManager renderManager, OSVR_RenderInfoCount whichEye,
+    OSVR_RenderTimingInfo* timingInfoOut)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    if (!IsUsable(rm) || !rm->bDisplayOpen || whichEye >= 2 || !timingInfoOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    double refreshHz;
+    {
+        Server& server = Server::Get();
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        refreshHz = server.GetOptions().refreshHz;
+    }
+    // vertical retraces at whole multiples of the interval since the epoch
+    const int64_t interval = osvrmock::ToMicros(1.0 / refreshHz);
+    const int64_t sinceRetrace = osvrMockClockNowMicros() % interval;
+    timingInfoOut->hardwareDisplayInterval = osvrmock::ToTimeValue(interval);
+    timingInfoOut->timeSincelastVerticalRetrace = osvrmock::ToTimeValue(sinceRetrace);
+    timingInfoOut->timeUntilNextPresentRequired = osvrmock::ToTimeValue(interval - sinceRetrace);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetDefaultRenderParams(OSVR_RenderParams* renderParamsOut)
+{
+    if (!renderParamsOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    renderParamsOut->worldFromRoomAppend = nullptr;
+    renderParamsOut->roomFromHeadReplace = nullptr;
+    renderParamsOut->nearClipDistanceMeters = 0.1;
+    renderParamsOut->farClipDistanceMeters = 100.0;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetNumRenderInfo(OSVR_RenderManager renderManager, OSVR_RenderParams /*renderParams*/,
+    OSVR_RenderInfoCount* numRenderInfoOut)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    if (!IsUsable(rm) || !rm->bDisplayOpen || !numRenderInfoOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *numRenderInfoOut = 2;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetRenderInfoOpenGL(OSVR_RenderManagerOpenGL renderManager, OSVR_RenderInfoCount renderInfoIndex,
+    OSVR_RenderParams renderParams, OSVR_RenderInfoOpenGL* renderInfoOut)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    if (!IsUsable(rm) || !rm->bDisplayOpen || renderInfoIndex >= 2 || !renderInfoOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+
+    // RenderManager pumps its client context for the latest head pose, once per
+    // frame, unless it's handed one
+    if (renderInfoIndex == 0 && !renderParams.roomFromHeadReplace) {
+        osvrClientUpdate(rm->Context);
+    }
+
+    OSVR_Pose3 head;
+    if (renderParams.roomFromHeadReplace) {
+        head = *renderParams.roomFromHeadReplace;
+    } else if (rm->Context->Viewer.bHasState) {
+        head = rm->Context->Viewer.PoseState;
+    } else {
+        head = osvrmock::MakePose(0.0, 0.0, 0.0, 0.0, 0.0);
+    }
+    const int eye = static_cast<int>(renderInfoIndex);
+    renderInfoOut->pose = osvrmock::GetEyePose(head, eye);
+
+    double left, right, bottom, top;
+    osvrmock::GetClippingPlanes(left, right, bottom, top);
+    const double nearClip = renderParams.nearClipDistanceMeters;
+    renderInfoOut->projection.left = left * nearClip;
+    renderInfoOut->projection.right = right * nearClip;
+    renderInfoOut->projection.bottom = bottom * nearClip;
+    renderInfoOut->projection.top = top * nearClip;
+    renderInfoOut->projection.nearClip = nearClip;
+    renderInfoOut->projection.farClip = renderParams.farClipDistanceMeters;
+
+    Server& server = Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    const osvrmock::Options& opts = server.GetOptions();
+    renderInfoOut->viewport.left = eye == 0 ? 0.0 : opts.eyeWidth;
+    renderInfoOut->viewport.lower = 0.0;
+    renderInfoOut->viewport.width = opts.eyeWidth;
+    renderInfoOut->viewport.height = opts.eyeHeight;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerStartRegisterRenderBuffers(OSVR_RenderManagerRegisterBufferState* registerBufferStateOut)
+{
+    if (!registerBufferStateOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *registerBufferStateOut = reinterpret_cast<OSVR_RenderManagerRegisterBufferState>(new BufferState());
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerRegisterRenderBufferOpenGL(OSVR_RenderManagerRegisterBufferState registerBufferState,
+    OSVR_RenderBufferOpenGL renderBuffer)
+{
+    if (!registerBufferState || renderBuffer.colorBufferName == 0) {
+        return OSVR_RETURN_FAILURE;
+    }
+    FromState(registerBufferState)->Buffers.push_back(renderBuffer);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerFinishRegisterRenderBuffers(OSVR_RenderManager renderManager,
+    OSVR_RenderManagerRegisterBufferState registerBufferState, OSVR_CBool /*appWillNotOverwriteBeforeNewPresent*/)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    BufferState* state = FromState(registerBufferState);
+    if (!state) {
+        return OSVR_RETURN_FAILURE;
+    }
+    const bool ok = IsUsable(rm) && rm->bDisplayOpen && !state->Buffers.empty();
+    if (ok) {
+        rm->Registered.insert(rm->Registered.end(), state->Buffers.begin(), state->Buffers.end());
+        Server& server = Server::Get();
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        server.GetStats().buffersRegistered += state->Buffers.size();
+    }
+    delete state;
+    return ok ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrRenderManagerStartPresentRenderBuffers(OSVR_RenderManagerPresentState* presentStateOut)
+{
+    if (!presentStateOut) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *presentStateOut = reinterpret_cast<OSVR_RenderManagerPresentState>(new BufferState());
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerPresentRenderBufferOpenGL(OSVR_RenderManagerPresentState presentState,
+    OSVR_RenderBufferOpenGL buffer, OSVR_RenderInfoOpenGL /*renderInfoUsed*/, OSVR_ViewportDescription /*normalizedCroppingViewport*/)
+{
+    if (!presentState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    FromState(presentState)->Buffers.push_back(buffer);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerFinishPresentRenderBuffers(OSVR_RenderManager renderManager,
+    OSVR_RenderManagerPresentState presentState, OSVR_RenderParams /*renderParams*/, OSVR_CBool /*shouldFlipY*/)
+{
+    RenderManager* rm = FromHandle(renderManager);
+    BufferState* state = FromState(presentState);
+    if (!state) {
+        return OSVR_RETURN_FAILURE;
+    }
+
+    bool ok = IsUsable(rm) && rm->bDisplayOpen && state->Buffers.size() == 2;
+    if (ok) {
+        // every presented buffer must have been registered first
+        for (const OSVR_RenderBufferOpenGL& buffer : state->Buffers) {
+            bool bRegistered = false;
+            for (const OSVR_RenderBufferOpenGL& registered : rm->Registered) {
+                bRegistered |= registered.colorBufferName == buffer.colorBufferName;
+            }
+            ok &= bRegistered;
+        }
+    }
+    delete state;
+
+    double presentSeconds = 0.0;
+    {
+        Server& server = Server::Get();
+        std::lock_guard<std::mutex> lock(server.GetMutex());
+        const osvrmock::Options& opts = server.GetOptions();
+        OSVRMockStats& stats = server.GetStats();
+        if (ok) {
+            rm->NumPresents++;
+            if (opts.renderManagerPresentFailEvery > 0 && rm->NumPresents % opts.renderManagerPresentFailEvery == 0) {
+                ok = false;
+            }
+        }
+        if (ok) {
+            stats.framesPresented++;
+            presentSeconds = opts.renderManagerPresentSeconds;
+        } else {
+            stats.presentFailures++;
+        }
+    }
+
+    // the time a real present blocks for; the manual clock is moved by the caller instead
+    if (presentSeconds > 0.0 && !osvrMockClockIsManual()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(osvrmock::ToMicros(presentSeconds)));
+    }
+
+    // a failed present leaves RenderManager needing to be recreated, like a lost device
+    if (!ok && rm) {
+        rm->bDoingOkay = false;
+    }
+    return ok ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
@@ -0,0 +1,503 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "MockServer.h"
+#include "MockClock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+
+namespace osvrmock {
+
+namespace {
+    const double Pi = 3.14159265358979323846;
+
+    double DegreesToRadians(double degrees)
+    {
+        return degrees * Pi / 180.0;
+    }
+
+    std::string Trim(const std::string& s)
+    {
+        const char* whitespace = " \t\r\n";
+        const size_t first = s.find_first_not_of(whitespace);
+        if (first == std::string::npos) {
+            return std::string();
+        }
+        return s.substr(first, s.find_last_not_of(whitespace) - first + 1);
+    }
+
+    bool ParseDouble(const std::string& value, double& out)
+    {
+        char* end = nullptr;
+        out = std::strtod(value.c_str(), &end);
+        return !value.empty() && *end == '\0';
+    }
+
+    bool ParseResolution(const std::string& value, int32_t& width, int32_t& height)
+    {
+        char* end = nullptr;
+        const long w = std::strtol(value.c_str(), &end, 10);
+        if (*end != 'x') {
+            return false;
+        }
+        const long h = std::strtol(end + 1, &end, 10);
+        if (*end != '\0' || w <= 0 || h <= 0) {
+            return false;
+        }
+        width = static_cast<int32_t>(w);
+        height = static_cast<int32_t>(h);
+        return true;
+    }
+
+    /** Stable per-path phase, so buttons on different paths don't all toggle together. */
+    double PathPhase(const std::string& path)
+    {
+        uint32_t hash = 2166136261u;
+        for (char c : path) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return (hash % 1000) / 1000.0;
+    }
+
+    void QuatMultiply(const OSVR_Quaternion& a, const OSVR_Quaternion& b, OSVR_Quaternion& out)
+    {
+        const double aw = a.data[0], ax = a.data[1], ay = a.data[2], az = a.data[3];
+        const double bw = b.data[0], bx = b.data[1], by = b.data[2], bz = b.data[3];
+        out.data[0] = aw * bw - ax * bx - ay * by - az * bz;
+        out.data[1] = aw * bx + ax * bw + ay * bz - az * by;
+        out.data[2] = aw * by - ax * bz + ay * bw + az * bx;
+        out.data[3] = aw * bz + ax * by - ay * bx + az * bw;
+    }
+
+    void QuatRotate(const OSVR_Quaternion& q, const double v[3], double out[3])
+    {
+        // v + 2w(u x v) + 2u x (u x v), u = vector part
+        const double w = q.data[0], x = q.data[1], y = q.data[2], z = q.data[3];
+        const double cx = y * v[2] - z * v[1];
+        const double cy = z * v[0] - x * v[2];
+        const double cz = x * v[1] - y * v[0];
+        out[0] = v[0] + 2.0 * (w * cx + y * cz - z * cy);
+        out[1] = v[1] + 2.0 * (w * cy + z * cx - x * cz);
+        out[2] = v[2] + 2.0 * (w * cz + x * cy - y * cx);
+    }
+}
+
+OSVR_Pose3 MakePose(double yawRadians, double pitchRadians, double x, double y, double z)
+{
+    // yaw about +y (up), then pitch about +x
+    OSVR_Quaternion yaw = { { std::cos(yawRadians / 2.0), 0.0, std::sin(yawRadians / 2.0), 0.0 } };
+    OSVR_Quaternion pitch = { { std::cos(pitchRadians / 2.0), std::sin(pitchRadians / 2.0), 0.0, 0.0 } };
+    OSVR_Pose3 pose;
+    QuatMultiply(yaw, pitch, pose.rotation);
+    pose.translation.data[0] = x;
+    pose.translation.data[1] = y;
+    pose.translation.data[2] = z;
+    return pose;
+}
+
+OSVR_Pose3 OffsetPose(const OSVR_Pose3& pose, double x, double y, double z)
+{
+    const double local[3] = { x, y, z };
+    double offset[3];
+    QuatRotate(pose.rotation, local, offset);
+    OSVR_Pose3 ret = pose;
+    for (int i = 0; i < 3; i++) {
+        ret.translation.data[i] += offset[i];
+    }
+    return ret;
+}
+
+bool RecordedTrajectory::Load(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    std::vector<Sample_t> samples;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = Trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        Sample_t sample;
+        OSVR_Pose3& pose = sample.Pose;
+        if (!(fields >> sample.Time
+            >> pose.translation.data[0] >> pose.translation.data[1] >> pose.translation.data[2]
+            >> pose.rotation.data[0] >> pose.rotation.data[1] >> pose.rotation.data[2] >> pose.rotation.data[3])) {
+            return false;
+        }
+        if (!samples.empty() && sample.Time <= samples.back().Time) {
+            return false;
+        }
+        samples.push_back(sample);
+    }
+    Samples.swap(samples);
+    return !Samples.empty();
+}
+
+OSVR_Pose3 RecordedTrajectory::Sample(double seconds) const
+{
+    const double start = Samples.front().Time;
+    const double duration = Samples.back().Time - start;
+    if (Samples.size() == 1 || duration <= 0.0) {
+        return Samples.front().Pose;
+    }
+    const double t = start + std::fmod(std::max(seconds, 0.0), duration);
+
+    size_t next = 1;
+    while (next + 1 < Samples.size() && Samples[next].Time < t) {
+        next++;
+    }
+    const Sample_t& a = Samples[next - 1];
+    const Sample_t& b = Samples[next];
+    const double alpha = std::min(std::max((t - a.Time) / (b.Time - a.Time), 0.0), 1.0);
+
+    OSVR_Pose3 pose;
+    for (int i = 0; i < 3; i++) {
+        pose.translation.data[i] = a.Pose.translation.data[i] + (b.Pose.translation.data[i] - a.Pose.translation.data[i]) * alpha;
+    }
+    // normalized lerp, the short way around
+    double dot = 0.0;
+    for (int i = 0; i < 4; i++) {
+        dot += a.Pose.rotation.data[i] * b.Pose.rotation.data[i];
+    }
+    const double sign = dot < 0.0 ? -1.0 : 1.0;
+    double length = 0.0;
+    for (int i = 0; i < 4; i++) {
+        pose.rotation.data[i] = a.Pose.rotation.data[i] + (sign * b.Pose.rotation.data[i] - a.Pose.rotation.data[i]) * alpha;
+        length += pose.rotation.data[i] * pose.rotation.data[i];
+    }
+    length = std::sqrt(length);
+    for (int i = 0; i < 4; i++) {
+        pose.rotation.data[i] = length > 0.0 ? pose.rotation.data[i] / length : (i == 0 ? 1.0 : 0.0);
+    }
+    return pose;
+}
+
+Server& Server::Get()
+{
+    static Server server;
+    return server;
+}
+
+Server::Server()
+{
+    Reset();
+}
+
+void Server::Reset()
+{
+    Opts = Options();
+    Recorded = RecordedTrajectory();
+    OpenFailuresLeft = 0;
+    std::memset(&Stats, 0, sizeof(Stats));
+    Restart();
+}
+
+void Server::Restart()
+{
+    StartMicros = osvrMockClockNowMicros();
+    bScheduledDownDone = false;
+    Generations.assign(1, Generation{ StartMicros, NoEnd, NoEnd });
+}
+
+int Server::SetOption(const std::string& key, const std::string& value)
+{
+    typedef std::function<bool(const std::string&)> Setter;
+    auto number = [](double& field) {
+        return Setter([&field](const std::string& v) { return ParseDouble(v, field); });
+    };
+    auto count = [](uint32_t& field) {
+        return Setter([&field](const std::string& v) {
+            double d;
+            if (!ParseDouble(v, d) || d < 0.0) {
+                return false;
+            }
+            field = static_cast<uint32_t>(d);
+            return true;
+        });
+    };
+
+    const std::map<std::string, Setter> setters = {
+        { "report_rate_hz", number(Opts.reportRateHz) },
+        { "latency_ms", Setter([this](const std::string& v) {
+            double ms;
+            return ParseDouble(v, ms) && (Opts.latencySeconds = ms / 1000.0) >= 0.0;
+        }) },
+        { "drop_rate", number(Opts.dropRate) },
+        { "seed", count(Opts.seed) },
+        { "connect_delay_s", number(Opts.connectDelaySeconds) },
+        { "display_startup_delay_s", number(Opts.displayStartupDelaySeconds) },
+        { "server_down_after_s", number(Opts.serverDownAfterSeconds) },
+        { "server_restart_after_s", number(Opts.serverRestartAfterSeconds) },
+        { "trajectory", Setter([this](const std::string& v) {
+            if (v != "static" && v != "sine") {
+                RecordedTrajectory recorded;
+                if (!recorded.Load(v)) {
+                    return false;
+                }
+                Recorded = recorded;
+            }
+            Opts.trajectory = v;
+            return true;
+        }) },
+        { "sine_yaw_deg", number(Opts.sineYawDegrees) },
+        { "sine_pitch_deg", number(Opts.sinePitchDegrees) },
+        { "sine_hz", number(Opts.sineHz) },
+        { "sine_sway_m", number(Opts.sineSwayMeters) },
+        { "button_period_s", number(Opts.buttonPeriodSeconds) },
+        { "eye_resolution", Setter([this](const std::string& v) {
+            return ParseResolution(v, Opts.eyeWidth, Opts.eyeHeight);
+        }) },
+        { "fov_h_deg", number(Opts.fovHorizontalDegrees) },
+        { "fov_v_deg", number(Opts.fovVerticalDegrees) },
+        { "ipd_m", number(Opts.ipdMeters) },
+        { "refresh_hz", number(Opts.refreshHz) },
+        { "rm_open_failures", Setter([this](const std::string& v) {
+            double d;
+            if (!ParseDouble(v, d) || d < 0.0) {
+                return false;
+            }
+            Opts.renderManagerOpenFailures = OpenFailuresLeft = static_cast<uint32_t>(d);
+            return true;
+        }) },
+        { "rm_present_fail_every", count(Opts.renderManagerPresentFailEvery) },
+        { "rm_present_ms", Setter([this](const std::string& v) {
+            double ms;
+            return ParseDouble(v, ms) && (Opts.renderManagerPresentSeconds = ms / 1000.0) >= 0.0;
+        }) },
+    };
+
+    auto setter = setters.find(key);
+    if (setter == setters.end() || !setter->second(Trim(value))) {
+        return -1;
+    }
+    if (Opts.reportRateHz <= 0.0) {
+        Opts.reportRateHz = 1.0;
+    }
+    if (Opts.refreshHz <= 0.0) {
+        Opts.refreshHz = 90.0;
+    }
+    return 0;
+}
+
+int Server::LoadConfig(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return -1;
+    }
+    int result = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            result = -1;
+            continue;
+        }
+        const std::string key = Trim(line.substr(0, equals));
+        std::string value = Trim(line.substr(equals + 1));
+        // recorded trajectories are found next to the config file
+        const size_t slash = path.rfind('/');
+        if (key == "trajectory" && value != "static" && value != "sine" && value[0] != '/' && slash != std::string::npos) {
+            value = path.substr(0, slash + 1) + value;
+        }
+        if (SetOption(key, value) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+void Server::LoadEnvironmentConfigOnce()
+{
+    if (bLoadedEnvironmentConfig) {
+        return;
+    }
+    bLoadedEnvironmentConfig = true;
+    const char* path = std::getenv("OSVR_MOCK_CONFIG");
+    if (path && *path) {
+        LoadConfig(path);
+    }
+}
+
+int64_t Server::GetReportPeriodMicros() const
+{
+    return std::max<int64_t>(ToMicros(1.0 / Opts.reportRateHz), 1);
+}
+
+void Server::Poll(int64_t nowMicros)
+{
+    if (!bScheduledDownDone && Opts.serverDownAfterSeconds > 0.0) {
+        const int64_t downMicros = StartMicros + ToMicros(Opts.serverDownAfterSeconds);
+        if (nowMicros >= downMicros) {
+            bScheduledDownDone = true;
+            if (IsUp()) {
+                Kill(downMicros, Opts.serverRestartAfterSeconds);
+            }
+        }
+    }
+    const Generation& current = Generations.back();
+    if (!IsUp() && nowMicros >= current.RestartMicros) {
+        Generations.push_back(Generation{ current.RestartMicros, NoEnd, NoEnd });
+    }
+}
+
+bool Server::IsReportLive(uint32_t generation, int64_t micros) const
+{
+    return generation < Generations.size()
+        && micros >= Generations[generation].StartMicros
+        && micros < Generations[generation].EndMicros;
+}
+
+void Server::Kill(int64_t nowMicros, double restartSeconds)
+{
+    if (!IsUp()) {
+        return;
+    }
+    Generation& current = Generations.back();
+    current.EndMicros = nowMicros;
+    current.RestartMicros = restartSeconds >= 0.0 ? nowMicros + ToMicros(restartSeconds) : NoEnd;
+}
+
+OSVR_Pose3 Server::GetHeadPose(double seconds) const
+{
+    if (Opts.trajectory == "static") {
+        return MakePose(0.0, 0.0, 0.0, 0.0, 0.0);
+    }
+    if (Opts.trajectory == "sine" || Recorded.IsEmpty()) {
+        const double phase = 2.0 * Pi * Opts.sineHz * seconds;
+        return MakePose(
+            DegreesToRadians(Opts.sineYawDegrees) * std::sin(phase),
+            DegreesToRadians(Opts.sinePitchDegrees) * std::sin(phase * 0.7),
+            Opts.sineSwayMeters * std::sin(phase * 0.5), 0.0, 0.0);
+    }
+    return Recorded.Sample(seconds);
+}
+
+OSVR_Pose3 Server::GetPathPose(const std::string& path, int64_t micros) const
+{
+    const OSVR_Pose3 head = GetHeadPose(static_cast<double>(micros - StartMicros) / MicrosPerSecond);
+    if (path == "/me/hands/left") {
+        return OffsetPose(head, -0.2, -0.3, -0.3);
+    }
+    if (path == "/me/hands/right") {
+        return OffsetPose(head, 0.2, -0.3, -0.3);
+    }
+    return head;
+}
+
+OSVR_ButtonState Server::GetButtonState(const std::string& path, int64_t micros) const
+{
+    const double period = std::max(Opts.buttonPeriodSeconds, 0.001);
+    const double cycles = static_cast<double>(micros - StartMicros) / MicrosPerSecond / period + PathPhase(path);
+    return (cycles - std::floor(cycles)) < 0.5 ? 1 : 0;
+}
+
+OSVR_AnalogState Server::GetAnalogState(const std::string& path, int64_t micros) const
+{
+    const double period = std::max(Opts.buttonPeriodSeconds, 0.001);
+    const double cycles = static_cast<double>(micros - StartMicros) / MicrosPerSecond / period + PathPhase(path);
+    return std::sin(2.0 * Pi * cycles);
+}
+
+std::string Server::GetDisplayDescriptor() const
+{
+    std::ostringstream json;
+    json << "{\"meta\":{\"schemaVersion\":1},\"hmd\":{\"device\":{\"vendor\":\"OSVR\",\"model\":\"Mock HMD\"},"
+        << "\"field_of_view\":{\"monocular_horizontal\":" << Opts.fovHorizontalDegrees
+        << ",\"monocular_vertical\":" << Opts.fovVerticalDegrees << "},"
+        << "\"resolutions\":[{\"width\":" << Opts.eyeWidth * 2 << ",\"height\":" << Opts.eyeHeight
+        << ",\"video_inputs\":1,\"display_mode\":\"horz_side_by_side\"}]}}";
+    return json.str();
+}
+
+bool Server::TakeOpenFailure()
+{
+    if (OpenFailuresLeft == 0) {
+        return false;
+    }
+    OpenFailuresLeft--;
+    return true;
+}
+
+} // namespace osvrmock
+
+int osvrMockLoadConfig(const char *path)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    return server.LoadConfig(path ? path : "");
+}
+
+int osvrMockSetOption(const char *key, const char *value)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    return server.SetOption(key ? key : "", value ? value : "");
+}
+
+void osvrMockReset(void)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    server.Reset();
+}
+
+void osvrMockUseManualClock(int enabled)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    osvrMockClockSetManual(enabled);
+    // the server's timeline is on the clock; start it over on the new one
+    server.Restart();
+}
+
+void osvrMockAdvanceClock(double seconds)
+{
+    osvrMockClockAdvanceMicros(osvrmock::ToMicros(seconds));
+}
+
+void osvrMockKillServer(double restartSeconds)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    const int64_t now = osvrMockClockNowMicros();
+    server.Poll(now);
+    server.Kill(now, restartSeconds);
+}
+
+void osvrMockGetStats(OSVRMockStats *stats)
+{
+    osvrmock::Server& server = osvrmock::Server::Get();
+    std::lock_guard<std::mutex> lock(server.GetMutex());
+    *stats = server.GetStats();
+}
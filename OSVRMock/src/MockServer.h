@@ -0,0 +1,161 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include "osvr_mock/MockControlC.h"
+
+#include <osvr/Util/ClientReportTypesC.h>
+#include <osvr/Util/Pose3C.h>
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace osvrmock {
+
+/** What the simulated server and display look like. See Documentation.md for the option names. */
+struct Options
+{
+    double reportRateHz = 1000.0;
+    double latencySeconds = 0.0;
+    double dropRate = 0.0;
+    uint32_t seed = 1;
+
+    double connectDelaySeconds = 0.0;
+    double displayStartupDelaySeconds = 0.0;
+    /** 0: never goes down on its own */
+    double serverDownAfterSeconds = 0.0;
+    /** Negative: doesn't come back */
+    double serverRestartAfterSeconds = -1.0;
+
+    /** "static", "sine", or the path of a recorded trajectory */
+    std::string trajectory = "sine";
+    double sineYawDegrees = 30.0;
+    double sinePitchDegrees = 10.0;
+    double sineHz = 0.5;
+    double sineSwayMeters = 0.05;
+    double buttonPeriodSeconds = 1.0;
+
+    int32_t eyeWidth = 1080;
+    int32_t eyeHeight = 1200;
+    double fovHorizontalDegrees = 100.0;
+    double fovVerticalDegrees = 110.0;
+    double ipdMeters = 0.063;
+    double refreshHz = 90.0;
+
+    uint32_t renderManagerOpenFailures = 0;
+    uint32_t renderManagerPresentFailEvery = 0;
+    double renderManagerPresentSeconds = 0.0;
+};
+
+/** A recorded head trajectory: "t,px,py,pz,qw,qx,qy,qz" lines, looped. */
+class RecordedTrajectory
+{
+public:
+    bool Load(const std::string& path);
+    bool IsEmpty() const { return Samples.empty(); }
+    OSVR_Pose3 Sample(double seconds) const;
+
+private:
+    struct Sample_t
+    {
+        double Time;
+        OSVR_Pose3 Pose;
+    };
+    std::vector<Sample_t> Samples;
+};
+
+/**
+* The simulated server. One per process, shared by all contexts; everything
+* is guarded by GetMutex().
+*
+* Reports are generated lazily, on a fixed grid of ReportRateHz from the
+* server start, when a context is updated, so what a context receives only
+* depends on the options and the clock.
+*/
+class Server
+{
+public:
+    static Server& Get();
+
+    std::mutex& GetMutex() { return Mutex; }
+
+    const Options& GetOptions() const { return Opts; }
+    int SetOption(const std::string& key, const std::string& value);
+    int LoadConfig(const std::string& path);
+    /** Loads OSVR_MOCK_CONFIG the first time it's called. */
+    void LoadEnvironmentConfigOnce();
+    void Reset();
+    /** Starts the server's timeline over at the current clock time, keeping the options. */
+    void Restart();
+
+    int64_t GetStartMicros() const { return StartMicros; }
+    int64_t GetReportPeriodMicros() const;
+
+    /** Applies the scheduled down/up times up to NowMicros. */
+    void Poll(int64_t nowMicros);
+    bool IsUp() const { return Generations.back().EndMicros == NoEnd; }
+    uint32_t GetGeneration() const { return static_cast<uint32_t>(Generations.size() - 1); }
+    /** @return True if a context connected in Generation gets the report made at Micros. */
+    bool IsReportLive(uint32_t generation, int64_t micros) const;
+    void Kill(int64_t nowMicros, double restartSeconds);
+
+    /** Pose of the tracked path at Micros, in room space. */
+    OSVR_Pose3 GetPathPose(const std::string& path, int64_t micros) const;
+    OSVR_ButtonState GetButtonState(const std::string& path, int64_t micros) const;
+    OSVR_AnalogState GetAnalogState(const std::string& path, int64_t micros) const;
+
+    /** The "/display" descriptor, changing with the display options. */
+    std::string GetDisplayDescriptor() const;
+
+    OSVRMockStats& GetStats() { return Stats; }
+
+    /** Takes one of the RenderManager open failures left, if any. */
+    bool TakeOpenFailure();
+
+private:
+    Server();
+
+    OSVR_Pose3 GetHeadPose(double seconds) const;
+
+    static const int64_t NoEnd = INT64_MAX;
+    struct Generation
+    {
+        int64_t StartMicros;
+        int64_t EndMicros;
+        int64_t RestartMicros;
+    };
+
+    std::mutex Mutex;
+    Options Opts;
+    RecordedTrajectory Recorded;
+    bool bLoadedEnvironmentConfig = false;
+    int64_t StartMicros = 0;
+    bool bScheduledDownDone = false;
+    std::vector<Generation> Generations;
+    uint32_t OpenFailuresLeft = 0;
+    OSVRMockStats Stats;
+};
+
+/** Quaternion and vector helpers; OSVR quaternions are w, x, y, z. */
+OSVR_Pose3 MakePose(double yawRadians, double pitchRadians, double x, double y, double z);
+OSVR_Pose3 OffsetPose(const OSVR_Pose3& pose, double x, double y, double z);
+
+} // namespace osvrmock
@@ -0,0 +1,96 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "MockClock.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace {
+    // where the manual clock starts, so runs with it are reproducible
+    const int64_t ManualClockEpochMicros = 1000000 * osvrmock::MicrosPerSecond;
+
+    std::atomic<int> gManualClock(0);
+    std::atomic<int64_t> gManualNowMicros(ManualClockEpochMicros);
+
+    int64_t SystemNowMicros()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+}
+
+int64_t osvrMockClockNowMicros(void)
+{
+    return gManualClock ? gManualNowMicros.load() : SystemNowMicros();
+}
+
+void osvrMockClockSetManual(int enabled)
+{
+    gManualNowMicros = ManualClockEpochMicros;
+    gManualClock = enabled ? 1 : 0;
+}
+
+int osvrMockClockIsManual(void)
+{
+    return gManualClock;
+}
+
+void osvrMockClockAdvanceMicros(int64_t micros)
+{
+    gManualNowMicros += micros;
+}
+
+void osvrTimeValueGetNow(OSVR_TimeValue *dest)
+{
+    *dest = osvrmock::ToTimeValue(osvrMockClockNowMicros());
+}
+
+void osvrTimeValueNormalize(OSVR_TimeValue *tv)
+{
+    const int64_t micros = tv->seconds * osvrmock::MicrosPerSecond + tv->microseconds;
+    *tv = osvrmock::ToTimeValue(micros);
+    if (tv->microseconds < 0) {
+        tv->seconds -= 1;
+        tv->microseconds += static_cast<OSVR_TimeValue_Microseconds>(osvrmock::MicrosPerSecond);
+    }
+}
+
+void osvrTimeValueSum(OSVR_TimeValue *tvA, const OSVR_TimeValue *tvB)
+{
+    tvA->seconds += tvB->seconds;
+    tvA->microseconds += tvB->microseconds;
+    osvrTimeValueNormalize(tvA);
+}
+
+void osvrTimeValueDifference(OSVR_TimeValue *tvA, const OSVR_TimeValue *tvB)
+{
+    tvA->seconds -= tvB->seconds;
+    tvA->microseconds -= tvB->microseconds;
+    osvrTimeValueNormalize(tvA);
+}
+
+int osvrTimeValueCmp(const OSVR_TimeValue *tvA, const OSVR_TimeValue *tvB)
+{
+    if (tvA->seconds != tvB->seconds) {
+        return tvA->seconds < tvB->seconds ? -1 : 1;
+    }
+    if (tvA->microseconds != tvB->microseconds) {
+        return tvA->microseconds < tvB->microseconds ? -1 : 1;
+    }
+    return 0;
+}
@@ -50,5 +50,17 @@ public class OSVR : ModuleRules
                             Path.Combine(EngineDir, @"Source\Runtime\Windows\D3D11RHI\Private\Windows")
     				        });
         }
+        else if (Target.Platform == UnrealTargetPlatform.Linux)
+        {
+            // The OpenGL custom present hands the RHI's GL textures to RenderManager.
+            PrivateDependencyModuleNames.AddRange(new string[] { "OpenGLDrv" });
+            AddEngineThirdPartyPrivateStaticDependencies(Target, "OpenGL");
+
+            var EngineDir = Path.GetFullPath(BuildConfiguration.RelativeEnginePath);
+            PrivateIncludePaths.AddRange(
+                new string[] {
+                            Path.Combine(EngineDir, "Source/Runtime/OpenGLDrv/Private")
+                            });
+        }
     }
 }
@@ -5,18 +5,35 @@
 #include "GameFramework/InputSettings.h"
 
 #include "OSVREntryPoint.h"
+#include "OSVRTrackingThread.h"
+#include "OSVRClockSync.h"
+#include "OSVRClientContext.h"
+#include "OSVRLibraryLoader.h"
+#include "OSVRStats.h"
 
 #include "OSVRHMD.h"
 
 DEFINE_LOG_CATEGORY(OSVRLog);
 
+DEFINE_STAT(STAT_OSVRPresent);
+DEFINE_STAT(STAT_OSVRContextLockWait);
+DEFINE_STAT(STAT_OSVRContextLockHeld);
+DEFINE_STAT(STAT_OSVRPresentLockWait);
+DEFINE_STAT(STAT_OSVRPresentLockHeld);
+
 class FOSVR : public IOSVR
 {
 private:
     TSharedPtr<FOSVRHMD, ESPMode::ThreadSafe> hmd;
     FCriticalSection mModuleMutex;
     TSharedPtr< class OSVREntryPoint > EntryPoint;
-    bool mModulesLoaded = false;
+    /** Owns the tracking thread. Game thread only. */
+    TSharedPtr< FOSVRTrackingThread, ESPMode::ThreadSafe > TrackingThread;
+    /** TrackingThread as GetTrackingThread() hands it out, from any thread */
+    FOSVRTrackingThread* volatile PublishedTrackingThread = nullptr;
+    TSharedPtr< FOSVRClockSync > ClockSync;
+    TSharedPtr< FOSVRClientContext, ESPMode::ThreadSafe > ClientContext;
+    FOSVRLibraryLoader LibraryLoader;
 public:
     /** IModuleInterface implementation */
     virtual void StartupModule() override;
@@ -30,7 +47,13 @@ public:
 
     virtual OSVREntryPoint* GetEntryPoint() override;
     virtual TSharedPtr<FOSVRHMD, ESPMode::ThreadSafe> GetHMD() override;
+    virtual FOSVRTrackingThread* GetTrackingThread() override;
+    virtual FOSVRClockSync* GetClockSync() override;
+    virtual TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> GetClientContext() override;
+    virtual void StartTrackingThread() override;
+    virtual void StopTrackingThread() override;
     virtual void LoadOSVRClientKitModule() override;
+    virtual bool LoadRenderManagerModule() override;
 };
 
 IMPLEMENT_MODULE(FOSVR, OSVR)
@@ -45,61 +68,32 @@ TSharedPtr<FOSVRHMD, ESPMode::ThreadSafe> FOSVR::GetHMD()
     return hmd;
 }
 
+FOSVRTrackingThread* FOSVR::GetTrackingThread()
+{
+    FOSVRTrackingThread* thread = PublishedTrackingThread;
+    return (thread && thread->IsRunning()) ? thread : nullptr;
+}
+
+FOSVRClockSync* FOSVR::GetClockSync()
+{
+    return ClockSync.Get();
+}
+
+TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> FOSVR::GetClientContext()
+{
+    return ClientContext;
+}
+
 void FOSVR::LoadOSVRClientKitModule()
 {
     FScopeLock lock(&mModuleMutex);
-    if (!mModulesLoaded) {
-#if PLATFORM_WINDOWS
-        const std::vector<std::string> osvrDlls = {
-            "osvrClientKit.dll",
-            "osvrClient.dll",
-            "osvrCommon.dll",
-            "osvrUtil.dll",
-            "osvrRenderManager.dll",
-            "d3dcompiler_47.dll",
-            "glew32.dll",
-            "SDL2.dll"
-        };
-#if PLATFORM_64BITS
-        std::vector<FString> pathsToTry = {
-            FPaths::GamePluginsDir() / "OSVR/Source/OSVRClientKit/bin/Win64/",
-            FPaths::EngineDir() / "Plugins/Runtime/OSVR/Source/OSVRClientKit/bin/Win64/",
-            FPaths::EngineDir() / "Binaries/ThirdParty/OSVRClientKit/bin/Win64/",
-            FPaths::EngineDir() / "Source/ThirdParty/OSVRClientKit/bin/Win64/"
-        };
-
-#else
-        std::vector<FString> pathsToTry = {
-            FPaths::GamePluginsDir() / "OSVR/Source/OSVRClientKit/bin/Win32/",
-            FPaths::EngineDir() / "Plugins/Runtime/OSVR/Source/OSVRClientKit/bin/Win32/",
-            FPaths::EngineDir() / "Binaries/ThirdParty/OSVRClientKit/bin/Win32/",
-            FPaths::EngineDir() / "Source/ThirdParty/OSVRClientKit/bin/Win32/"
-        };
-#endif
-#endif
-        FString osvrClientKitLibPath;
-        for (size_t i = 0; i < pathsToTry.size(); i++) {
-            if (FPaths::DirectoryExists(pathsToTry[i])) {
-                osvrClientKitLibPath = pathsToTry[i];
-                break;
-            }
-        }
-        if (osvrClientKitLibPath.Len() == 0) {
-            UE_LOG(OSVRLog, Warning, TEXT("Could not find OSVRClientKit module binaries in either the engine plugins or game plugins folder."));
-            return;
-        }
-        FPlatformProcess::PushDllDirectory(*osvrClientKitLibPath);
-        for (size_t i = 0; i < osvrDlls.size(); i++) {
-            void* libHandle = nullptr;
-            auto path = osvrClientKitLibPath + osvrDlls[i].c_str();
-            libHandle = FPlatformProcess::GetDllHandle(*path);
-            if (!libHandle) {
-                UE_LOG(OSVRLog, Warning, TEXT("FAILED to load %s"), *path);
-            }
-        }
-        FPlatformProcess::PopDllDirectory(*osvrClientKitLibPath);
-        mModulesLoaded = true;
-    }
+    LibraryLoader.LoadClientKit();
+}
+
+bool FOSVR::LoadRenderManagerModule()
+{
+    FScopeLock lock(&mModuleMutex);
+    return LibraryLoader.LoadRenderManager();
 }
 
 TSharedPtr< class IHeadMountedDisplay, ESPMode::ThreadSafe > FOSVR::CreateHeadMountedDisplay()
@@ -107,6 +101,7 @@ TSharedPtr< class IHeadMountedDisplay, ESPMode::ThreadSafe > FOSVR::CreateHeadMo
     TSharedPtr< FOSVRHMD, ESPMode::ThreadSafe > OSVRHMD(new FOSVRHMD());
     if (OSVRHMD->IsInitialized())
     {
+        // The HMD may still be connecting; it starts the tracking thread once it's connected.
         hmd = OSVRHMD;
         return OSVRHMD;
     }
@@ -114,17 +109,65 @@ TSharedPtr< class IHeadMountedDisplay, ESPMode::ThreadSafe > FOSVR::CreateHeadMo
     return nullptr;
 }
 
+void FOSVR::StartTrackingThread()
+{
+    check(IsInGameThread());
+    if (TrackingThread.IsValid() || !hmd.IsValid() || !FOSVRTrackingThread::IsEnabled())
+    {
+        return;
+    }
+
+    // Start() waits for the thread's Init, which takes the client context
+    // mutex, and the context calls GetTrackingThread() under that mutex; so
+    // only publish the thread once it's up.
+    TSharedPtr< FOSVRTrackingThread, ESPMode::ThreadSafe > thread = MakeShareable(new FOSVRTrackingThread(
+        ClientContext->Get(), &ClientContext->GetMutex(), hmd->GetDisplayConfig()));
+    if (thread->Start())
+    {
+        TrackingThread = thread;
+        FPlatformAtomics::InterlockedExchangePtr((void**)&PublishedTrackingThread, thread.Get());
+    }
+}
+
+void FOSVR::StopTrackingThread()
+{
+    check(IsInGameThread());
+    if (!TrackingThread.IsValid())
+    {
+        return;
+    }
+    FPlatformAtomics::InterlockedExchangePtr((void**)&PublishedTrackingThread, nullptr);
+    TrackingThread->Shutdown();
+
+    // Render commands already queued may still read the thread's buffers, so
+    // it's deleted on the render thread after them.
+    typedef TSharedPtr< FOSVRTrackingThread, ESPMode::ThreadSafe > FTrackingThreadPtr;
+    ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRDeleteTrackingThread,
+        FTrackingThreadPtr, thread, TrackingThread,
+        {
+            thread.Reset();
+        });
+    TrackingThread = nullptr;
+}
+
 void FOSVR::StartupModule()
 {
     LoadOSVRClientKitModule();
     IHeadMountedDisplayModule::StartupModule();
 
-    EntryPoint = MakeShareable(new OSVREntryPoint());
+    ClockSync = MakeShareable(new FOSVRClockSync());
+    ClientContext = MakeShareable(new FOSVRClientContext());
+    EntryPoint = MakeShareable(new OSVREntryPoint(ClientContext));
 }
 
 void FOSVR::ShutdownModule()
 {
+    // stop the tracking thread before anything it samples goes away
+    StopTrackingThread();
     EntryPoint = nullptr;
+    // the context itself stays up until the HMD and the custom present let go of it too
+    ClientContext = nullptr;
+    ClockSync = nullptr;
 
     IHeadMountedDisplayModule::ShutdownModule();
 }
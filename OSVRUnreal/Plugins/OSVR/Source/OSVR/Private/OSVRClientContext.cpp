@@ -0,0 +1,260 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRClientContext.h"
+#include "OSVRTrackingThread.h"
+
+namespace {
+    TAutoConsoleVariable<float> CVarOSVRReconnectTimeout(
+        TEXT("osvr.ReconnectTimeout"),
+        2.0f,
+        TEXT("Seconds the client context may stay disconnected from the OSVR server before a new one is built in\n")
+        TEXT("the background. Trackers that stop reporting don't count. 0 disables reconnecting."),
+        ECVF_Default);
+
+    const char* const AppId = "com.osvr.unreal.plugin";
+
+    // How long one reconnect attempt may wait for the server and the display
+    const double ReconnectAttemptSeconds = 10.0;
+
+    // Backoff between failed reconnect attempts
+    const double MinReconnectRetrySeconds = 1.0;
+    const double MaxReconnectRetrySeconds = 10.0;
+}
+
+FOSVRClientContext::FOSVRClientContext()
+{
+}
+
+FOSVRClientContext::~FOSVRClientContext()
+{
+    if (bReconnecting) {
+        // the listeners are gone already, so there's nobody to abort
+        FPlatformAtomics::InterlockedExchange(&bCancelReconnect, 1);
+        ReconnectTask.Wait();
+        if (NewContext) {
+            osvrClientShutdown(NewContext);
+        }
+    }
+    if (Context) {
+        UE_LOG(OSVRLog, Warning, TEXT("The OSVR client context still has %d consumers when going away. Shutting it down anyway."), NumConsumers);
+        osvrClientShutdown(Context);
+    }
+}
+
+OSVR_ClientContext FOSVRClientContext::Register(const TCHAR* Consumer, IOSVRClientContextListener* Listener)
+{
+    if (Listener && bReconnecting) {
+        // it's getting its handles from the old context, which the attempt would shut down
+        CancelReconnect();
+    }
+
+    FScopeLock registrationLock(&RegistrationMutex);
+    if (NumConsumers == 0) {
+        FScopeLock lock(&Mutex);
+        Context = osvrClientInit(AppId);
+        LastUpdateFrame = MAX_uint64;
+        LastUpdateResult = OSVR_RETURN_SUCCESS;
+        bConnected = false;
+        bHasConnected = false;
+        DisconnectedTime = 0.0;
+    }
+    NumConsumers++;
+    if (Listener) {
+        Listeners.Add(Listener);
+    }
+    UE_LOG(OSVRLog, Log, TEXT("%s registered with the OSVR client context (%d consumers)."), Consumer, NumConsumers);
+    return Context;
+}
+
+void FOSVRClientContext::Unregister(const TCHAR* Consumer, IOSVRClientContextListener* Listener)
+{
+    if (Listener && bReconnecting) {
+        CancelReconnect();
+    }
+
+    FScopeLock registrationLock(&RegistrationMutex);
+    check(NumConsumers > 0);
+    NumConsumers--;
+    if (Listener) {
+        Listeners.Remove(Listener);
+    }
+    UE_LOG(OSVRLog, Log, TEXT("%s unregistered from the OSVR client context (%d consumers)."), Consumer, NumConsumers);
+    if (NumConsumers == 0 && Context) {
+        FScopeLock lock(&Mutex);
+        osvrClientShutdown(Context);
+        Context = nullptr;
+        bConnected = false;
+    }
+}
+
+OSVR_ReturnCode FOSVRClientContext::Update()
+{
+    check(IsInGameThread());
+    if (LastUpdateFrame == GFrameCounter) {
+        return LastUpdateResult;
+    }
+    LastUpdateFrame = GFrameCounter;
+
+    if (bReconnecting && ReconnectTask.IsReady()) {
+        FinishReconnect();
+    }
+
+    {
+        FOSVRContextScopeLock lock(&Mutex);
+        if (!Context) {
+            LastUpdateResult = OSVR_RETURN_FAILURE;
+            bConnected = false;
+            return LastUpdateResult;
+        }
+
+        // the tracking thread, when running, is the only thing pumping the context
+        if (!IOSVR::Get().GetTrackingThread()) {
+            LastUpdateResult = osvrClientUpdate(Context);
+        }
+        bConnected = LastUpdateResult != OSVR_RETURN_FAILURE && osvrClientCheckStatus(Context) == OSVR_RETURN_SUCCESS;
+    }
+
+    if (bConnected) {
+        bHasConnected = true;
+        DisconnectedTime = 0.0;
+    } else if (bHasConnected && DisconnectedTime == 0.0) {
+        DisconnectedTime = FPlatformTime::Seconds();
+    }
+
+    if (IsConnectionLost() && !bReconnecting && FPlatformTime::Seconds() >= NextReconnectTime) {
+        StartReconnect();
+    }
+    return LastUpdateResult;
+}
+
+bool FOSVRClientContext::IsConnectionLost() const
+{
+    const float timeout = CVarOSVRReconnectTimeout.GetValueOnGameThread();
+    return timeout > 0.0f && DisconnectedTime != 0.0 && FPlatformTime::Seconds() - DisconnectedTime > timeout;
+}
+
+void FOSVRClientContext::StartReconnect()
+{
+    check(IsInGameThread());
+    UE_LOG(OSVRLog, Warning, TEXT("Lost the connection to the OSVR server for %.1f s. Reconnecting in the background."),
+        CVarOSVRReconnectTimeout.GetValueOnGameThread());
+
+    {
+        FScopeLock registrationLock(&RegistrationMutex);
+        ReconnectListeners = Listeners;
+    }
+    NewContext = nullptr;
+    NumPreparedListeners = 0;
+    ReconnectDeadline = FPlatformTime::Seconds() + ReconnectAttemptSeconds;
+    bCancelReconnect = 0;
+    bReconnecting = true;
+    ReconnectTask = Async<bool>(EAsyncExecution::Thread, [this]() {
+        return RunReconnect();
+    });
+}
+
+bool FOSVRClientContext::PumpNewContextUntil(OSVR_ClientContext InNewContext, const TFunction<bool()>& Condition)
+{
+    while (!Condition()) {
+        if (bCancelReconnect || FPlatformTime::Seconds() > ReconnectDeadline) {
+            return false;
+        }
+        osvrClientUpdate(InNewContext);
+        FPlatformProcess::Sleep(0.01f);
+    }
+    return true;
+}
+
+bool FOSVRClientContext::RunReconnect()
+{
+    NewContext = osvrClientInit(AppId);
+    if (!NewContext || !PumpNewContextUntil(NewContext, [this]() { return osvrClientCheckStatus(NewContext) == OSVR_RETURN_SUCCESS; })) {
+        return false;
+    }
+
+    for (IOSVRClientContextListener* listener : ReconnectListeners) {
+        if (bCancelReconnect || !listener->PrepareReconnect(NewContext)) {
+            return false;
+        }
+        NumPreparedListeners++;
+    }
+    return !bCancelReconnect;
+}
+
+void FOSVRClientContext::FinishReconnect()
+{
+    check(IsInGameThread());
+    const bool bReady = ReconnectTask.Get();
+    bReconnecting = false;
+
+    if (!bReady) {
+        for (int32 i = 0; i < NumPreparedListeners; i++) {
+            ReconnectListeners[i]->AbortReconnect(NewContext);
+        }
+        if (NewContext) {
+            osvrClientShutdown(NewContext);
+        }
+        NewContext = nullptr;
+        ReconnectListeners.Reset();
+
+        ReconnectRetryInterval = FMath::Clamp(ReconnectRetryInterval * 2.0, MinReconnectRetrySeconds, MaxReconnectRetrySeconds);
+        NextReconnectTime = FPlatformTime::Seconds() + ReconnectRetryInterval;
+        if (!bCancelReconnect) {
+            UE_LOG(OSVRLog, Warning, TEXT("Could not reconnect to the OSVR server. Trying again in %.1f s."), ReconnectRetryInterval);
+        }
+        return;
+    }
+
+    for (IOSVRClientContextListener* listener : ReconnectListeners) {
+        listener->BeginReconnect();
+    }
+    {
+        FScopeLock lock(&Mutex);
+        OSVR_ClientContext oldContext = Context;
+        for (IOSVRClientContextListener* listener : ReconnectListeners) {
+            listener->CommitReconnect(oldContext, NewContext);
+        }
+        Context = NewContext;
+
+        // The render thread may still use the old context (RenderManager) until
+        // it has run what the listeners queued in BeginReconnect.
+        ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRShutdownClientContext,
+            OSVR_ClientContext, context, oldContext,
+            {
+                osvrClientShutdown(context);
+            });
+    }
+    for (IOSVRClientContextListener* listener : ReconnectListeners) {
+        listener->EndReconnect();
+    }
+
+    NewContext = nullptr;
+    ReconnectListeners.Reset();
+    ReconnectRetryInterval = 0.0;
+    bHasConnected = false;
+    DisconnectedTime = 0.0;
+    UE_LOG(OSVRLog, Log, TEXT("Reconnected to the OSVR server."));
+}
+
+void FOSVRClientContext::CancelReconnect()
+{
+    check(IsInGameThread());
+    FPlatformAtomics::InterlockedExchange(&bCancelReconnect, 1);
+    ReconnectTask.Wait();
+    FinishReconnect();
+}
@@ -0,0 +1,198 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include "Async/Async.h"
+#include "OSVRStats.h"
+
+/**
+* Implemented by consumers that hold handles (interfaces, display configs,
+* callbacks) from the client context, so they can be moved over to a new
+* context when the server restarts. See FOSVRClientContext.
+*/
+class IOSVRClientContextListener
+{
+public:
+    virtual ~IOSVRClientContextListener() {}
+
+    /**
+    * Called on the reconnect task. Acquires from NewContext, which is already
+    * connected to the server, everything that will replace what's held from
+    * the current context, without using it yet. Clean up after yourself
+    * before returning false.
+    *
+    * @return False to give up on this reconnect attempt.
+    */
+    virtual bool PrepareReconnect(OSVR_ClientContext NewContext) = 0;
+
+    /**
+    * Called on the game thread before the swap, without the context mutex
+    * held. Stops whatever uses the current context off the game thread. The
+    * render thread may be told to with a render command instead: the old
+    * context is shut down on the render thread, after the commands queued by then.
+    */
+    virtual void BeginReconnect() {}
+
+    /**
+    * Called on the game thread, under the context mutex. Switches to what was
+    * prepared and frees what came from OldContext, which is shut down after.
+    */
+    virtual void CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext) = 0;
+
+    /** Called on the game thread after the swap. */
+    virtual void EndReconnect() {}
+
+    /** Frees what a successful PrepareReconnect got from NewContext; the attempt was abandoned. */
+    virtual void AbortReconnect(OSVR_ClientContext NewContext) = 0;
+};
+
+/**
+* The one OSVR client context of the plugin, shared by the entry point, the
+* HMD, the custom present and the input device.
+*
+* Each consumer registers when it starts using the context and unregisters
+* when it's done with it; the context is created by the first registration
+* and shut down when the last consumer unregisters, whatever order they go
+* away in. Consumers that can outlive the module (the HMD and the custom
+* present, which the engine owns) keep a shared pointer to this object too.
+*
+* Update() is the one place the context is pumped from on the game thread,
+* at most once per engine frame. The tracking thread, when running, pumps it
+* instead, and the render thread may read controller poses from it or
+* create and destroy RenderManager with it, so any ClientKit or RenderManager
+* call that may touch the context, from any thread, must hold GetMutex();
+* that includes creating and freeing interfaces and registering callbacks.
+* Take it with FOSVRContextScopeLock, so contention on it shows in
+* "stat OSVR". Calls on a replacement context that is still being prepared
+* (see below) don't need it, since nothing else can reach that context yet.
+*
+* When the context has lost its connection to the server (osvrClientCheckStatus
+* fails) for osvr.ReconnectTimeout seconds, the server is considered gone. A new context is then built on a background
+* task, and the consumers registered as listeners prepare their handles on
+* it there. Once everything is ready, Update() swaps it in on the game thread
+* in one step and has the render thread shut the old context down once it's
+* done with it. Until then consumers keep using
+* the old context (and the last reports it got).
+*/
+class FOSVRClientContext
+{
+public:
+    FOSVRClientContext();
+    ~FOSVRClientContext();
+
+    /**
+    * Registers a consumer of the context, creating the context if it's the first.
+    *
+    * @param Consumer Name of the consumer, for the log.
+    * @param Listener Set if the consumer holds handles from the context. Game thread only then.
+    * @return The context, or nullptr if it couldn't be created.
+    */
+    OSVR_ClientContext Register(const TCHAR* Consumer, IOSVRClientContextListener* Listener = nullptr);
+
+    /** Unregisters a consumer. The last one to go shuts the context down. */
+    void Unregister(const TCHAR* Consumer, IOSVRClientContextListener* Listener = nullptr);
+
+    /**
+    * @return The context, or nullptr while nobody is registered. It changes
+    * when reconnecting, so don't keep it beyond a frame unless you're a listener.
+    */
+    OSVR_ClientContext Get() const
+    {
+        return Context;
+    }
+
+    FCriticalSection& GetMutex()
+    {
+        return Mutex;
+    }
+
+    /**
+    * Pumps the context, at most once per engine frame and not at all while
+    * the tracking thread runs. Game thread only. Calling it again in the same
+    * frame just returns the result of the first call, so every consumer sees
+    * the same server state for the frame. Also drives reconnecting.
+    *
+    * @return The result of this frame's osvrClientUpdate call.
+    */
+    OSVR_ReturnCode Update();
+
+    /** @return True if the context was connected to the server at this frame's Update(). */
+    bool IsConnected() const
+    {
+        return bConnected;
+    }
+
+    /** @return True while a new context is being built in the background. */
+    bool IsReconnecting() const
+    {
+        return bReconnecting;
+    }
+
+    /**
+    * For listeners' PrepareReconnect: pumps the new context until Condition
+    * holds, or the reconnect attempt times out or is cancelled.
+    *
+    * @return True if Condition held.
+    */
+    bool PumpNewContextUntil(OSVR_ClientContext NewContext, const TFunction<bool()>& Condition);
+
+private:
+    FOSVRClientContext(const FOSVRClientContext&);
+    FOSVRClientContext& operator=(const FOSVRClientContext&);
+
+    /** @return True if the connection to the server has been down for longer than the timeout. */
+    bool IsConnectionLost() const;
+
+    void StartReconnect();
+
+    /** Runs on the reconnect task. */
+    bool RunReconnect();
+
+    /** Swaps in the new context, or cleans up after a failed attempt. Game thread. */
+    void FinishReconnect();
+
+    /** Abandons a reconnect in progress. Game thread. */
+    void CancelReconnect();
+
+    OSVR_ClientContext Context = nullptr;
+    int32 NumConsumers = 0;
+    TArray<IOSVRClientContextListener*> Listeners;
+    FCriticalSection RegistrationMutex;
+    FCriticalSection Mutex;
+
+    uint64 LastUpdateFrame = MAX_uint64;
+    OSVR_ReturnCode LastUpdateResult = OSVR_RETURN_SUCCESS;
+    bool bConnected = false;
+
+    /** True once the context has connected; a context that never did hasn't lost anything */
+    bool bHasConnected = false;
+    /** FPlatformTime::Seconds when the connection went down, zero while it's up */
+    double DisconnectedTime = 0.0;
+
+    // Reconnect state. The task only touches the new context, the listener
+    // snapshot and the counters below; the game thread waits for it before
+    // touching them.
+    bool bReconnecting = false;
+    TFuture<bool> ReconnectTask;
+    OSVR_ClientContext NewContext = nullptr;
+    TArray<IOSVRClientContextListener*> ReconnectListeners;
+    int32 NumPreparedListeners = 0;
+    double ReconnectDeadline = 0.0;
+    volatile int32 bCancelReconnect = 0;
+    double NextReconnectTime = 0.0;
+    double ReconnectRetryInterval = 0.0;
+};
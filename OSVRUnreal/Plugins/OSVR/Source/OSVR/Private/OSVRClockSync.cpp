@@ -0,0 +1,124 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRClockSync.h"
+#include "OSVRTypes.h"
+
+namespace {
+    // Offsets measured closer together than this are too noisy to get a drift from.
+    const double MinDriftBaselineSeconds = 10.0;
+
+    // Weight of the newest drift measurement in the smoothed estimate.
+    const double DriftSmoothing = 0.25;
+
+    // Real clocks are off by a few tens of ppm; anything above is a measurement error.
+    const double MaxDrift = 0.001;
+
+    double CyclesToSeconds(uint64 Cycles)
+    {
+        return static_cast<double>(Cycles) * FPlatformTime::GetSecondsPerCycle64();
+    }
+}
+
+FOSVRClockSync::FOSVRClockSync()
+{
+    osvrTimeValueGetNow(&Reference);
+    AddSample();
+}
+
+void FOSVRClockSync::Update()
+{
+    FScopeLock lock(&Mutex);
+    AddSample();
+}
+
+void FOSVRClockSync::AddSample()
+{
+    const uint64 before = FPlatformTime::Cycles64();
+    OSVR_TimeValue now;
+    osvrTimeValueGetNow(&now);
+    const uint64 after = FPlatformTime::Cycles64();
+
+    FSample& sample = Window[NextSample];
+    sample.EngineSeconds = CyclesToSeconds(before) + CyclesToSeconds(after - before) / 2.0;
+    sample.OSVRSeconds = osvrTimeValueDurationSeconds(&now, &Reference);
+    sample.RoundTripSeconds = CyclesToSeconds(after - before);
+    NextSample = (NextSample + 1) % WindowSize;
+    NumSamples = FMath::Min(NumSamples + 1, WindowSize);
+
+    const FSample* best = &Window[0];
+    for (int32 i = 1; i < NumSamples; i++) {
+        if (Window[i].RoundTripSeconds < best->RoundTripSeconds) {
+            best = &Window[i];
+        }
+    }
+
+    const bool bFirstSample = NumSamples == 1;
+    EstimateEngineSeconds = best->EngineSeconds;
+    EstimateOffset = best->OSVRSeconds - best->EngineSeconds;
+
+    if (bFirstSample) {
+        AnchorEngineSeconds = EstimateEngineSeconds;
+        AnchorOffset = EstimateOffset;
+        return;
+    }
+
+    const double baseline = EstimateEngineSeconds - AnchorEngineSeconds;
+    if (baseline >= MinDriftBaselineSeconds) {
+        const double measured = FMath::Clamp((EstimateOffset - AnchorOffset) / baseline, -MaxDrift, MaxDrift);
+        Drift = bHasDrift ? FMath::Lerp(Drift, measured, DriftSmoothing) : measured;
+        bHasDrift = true;
+        AnchorEngineSeconds = EstimateEngineSeconds;
+        AnchorOffset = EstimateOffset;
+    }
+}
+
+double FOSVRClockSync::EngineToOSVRSeconds(double EngineSeconds) const
+{
+    return EngineSeconds + EstimateOffset + Drift * (EngineSeconds - EstimateEngineSeconds);
+}
+
+double FOSVRClockSync::OSVRToEngineSeconds(double OSVRSeconds) const
+{
+    return (OSVRSeconds - EstimateOffset + Drift * EstimateEngineSeconds) / (1.0 + Drift);
+}
+
+uint64 FOSVRClockSync::OSVRToCycles64(const OSVR_TimeValue& Time) const
+{
+    FScopeLock lock(&Mutex);
+    const double seconds = OSVRToEngineSeconds(osvrTimeValueDurationSeconds(&Time, &Reference));
+    return seconds > 0.0 ? static_cast<uint64>(seconds / FPlatformTime::GetSecondsPerCycle64()) : 0;
+}
+
+OSVR_TimeValue FOSVRClockSync::Cycles64ToOSVR(uint64 Cycles) const
+{
+    FScopeLock lock(&Mutex);
+    return OSVRTimeValueAddSeconds(Reference, EngineToOSVRSeconds(CyclesToSeconds(Cycles)));
+}
+
+double FOSVRClockSync::GetAgeSeconds(const OSVR_TimeValue& Time) const
+{
+    const double now = CyclesToSeconds(FPlatformTime::Cycles64());
+    FScopeLock lock(&Mutex);
+    return now - OSVRToEngineSeconds(osvrTimeValueDurationSeconds(&Time, &Reference));
+}
+
+double FOSVRClockSync::GetDrift() const
+{
+    FScopeLock lock(&Mutex);
+    return Drift;
+}
@@ -0,0 +1,90 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <osvr/Util/TimeValueC.h>
+
+/**
+* Relates the OSVR clock (OSVR_TimeValue) to the engine's high resolution
+* clock (FPlatformTime::Cycles64).
+*
+* Each Update() reads both clocks back to back. The sample with the shortest
+* round trip in a sliding window gives the offset, since it's the one least
+* disturbed by preemption; offsets of such samples taken far enough apart give
+* the drift between the two clocks. All methods are thread safe.
+*/
+class FOSVRClockSync
+{
+public:
+    /** Takes a first sample, so conversions are usable right away. */
+    FOSVRClockSync();
+
+    /** Takes one paired sample and refines the estimate. Cheap; call once per frame or more. */
+    void Update();
+
+    /** @return The FPlatformTime::Cycles64() value at OSVR time Time. */
+    uint64 OSVRToCycles64(const OSVR_TimeValue& Time) const;
+
+    /** @return The OSVR time at FPlatformTime::Cycles64() value Cycles. */
+    OSVR_TimeValue Cycles64ToOSVR(uint64 Cycles) const;
+
+    /** @return How long ago, in seconds, OSVR time Time was. */
+    double GetAgeSeconds(const OSVR_TimeValue& Time) const;
+
+    /** @return How much faster the OSVR clock runs than the engine clock, in seconds per second. */
+    double GetDrift() const;
+
+private:
+    struct FSample
+    {
+        /** Engine time halfway through the round trip */
+        double EngineSeconds;
+        /** OSVR time relative to Reference */
+        double OSVRSeconds;
+        double RoundTripSeconds;
+    };
+
+    static const int32 WindowSize = 32;
+
+    void AddSample();
+
+    /**
+    * Engine times are Cycles64 in seconds; OSVR times are seconds relative to
+    * Reference. Callers hold the lock.
+    */
+    double EngineToOSVRSeconds(double EngineSeconds) const;
+    double OSVRToEngineSeconds(double OSVRSeconds) const;
+
+    mutable FCriticalSection Mutex;
+
+    /** OSVR times are kept relative to this, so doubles don't lose precision */
+    OSVR_TimeValue Reference;
+
+    FSample Window[WindowSize];
+    int32 NumSamples = 0;
+    int32 NextSample = 0;
+
+    /** Offset (OSVR minus engine) at engine time EstimateEngineSeconds */
+    double EstimateEngineSeconds = 0.0;
+    double EstimateOffset = 0.0;
+    double Drift = 0.0;
+    bool bHasDrift = false;
+
+    /** Older estimate the drift is measured against */
+    double AnchorEngineSeconds = 0.0;
+    double AnchorOffset = 0.0;
+};
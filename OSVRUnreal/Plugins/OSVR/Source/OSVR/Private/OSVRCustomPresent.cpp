@@ -18,3 +18,17 @@
 #include "OSVRCustomPresent.h"
 
 DEFINE_LOG_CATEGORY(FOSVRCustomPresentLog);
+
+namespace {
+    TAutoConsoleVariable<int32> CVarOSVRSwapChainLength(
+        TEXT("osvr.SwapChainLength"),
+        3,
+        TEXT("Number of render targets (1 to 3) rotated through and registered with RenderManager, so a frame\n")
+        TEXT("can be rendered while RenderManager still reads the previous one. D3D11 only; read when the render target is allocated."),
+        ECVF_Default);
+}
+
+int32 OSVRGetSwapChainLength()
+{
+    return FMath::Clamp(CVarOSVRSwapChainLength.GetValueOnAnyThread(), 1, 3);
+}
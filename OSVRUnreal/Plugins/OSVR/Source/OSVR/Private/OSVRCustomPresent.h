@@ -17,31 +17,90 @@
 #pragma once
 
 #include "IOSVR.h"
+#include "OSVRClientContext.h"
+#include "OSVRSeqLock.h"
+#include "Async/Future.h"
+#include <osvr/Util/Pose3C.h>
 #include <osvr/RenderKit/RenderManagerC.h>
 #include <vector>
 
 DECLARE_LOG_CATEGORY_EXTERN(FOSVRCustomPresentLog, Log, All);
 
+/**
+* @return osvr.SwapChainLength, the number of render targets the D3D11 present
+* rotates through, clamped to [1, 3].
+*/
+int32 OSVRGetSwapChainLength();
+
+/** Lifecycle of the custom present's RenderManager. */
+enum EOSVRPresentState
+{
+    /** No RenderManager yet */
+    PRESENT_CREATED = 0,
+    /** RenderManager being created and its display opened, in the background */
+    PRESENT_OPENING,
+    /** Display open, no render buffers registered yet */
+    PRESENT_OPENED,
+    /** Render buffers registered, nothing presented yet */
+    PRESENT_BUFFERS_REGISTERED,
+    /** Frames are being presented */
+    PRESENT_PRESENTING,
+    /** Opening or presenting failed; the RenderManager is gone until the next attempt */
+    PRESENT_LOST
+};
+
+/** What RenderManager said about the display when its render infos were last queried. */
+struct FOSVRRenderConfig
+{
+    /** (0, 0) while unknown */
+    FIntPoint RenderTargetSize;
+
+    FOSVRRenderConfig() :
+        RenderTargetSize(FIntPoint::ZeroValue)
+    {
+    }
+};
+
+/**
+* Presents the engine's render target through RenderManager.
+*
+* The display is opened where the API specific present puts it (see
+* StartOpenDisplay) while the state is PRESENT_OPENING and nothing else
+* touches the RenderManager. Once it's open, only the render thread uses the RenderManager and the present state
+* (render infos, render buffers, viewport descriptions, render head pose), or
+* drops it again; the game thread asks for that with render commands, see
+* Reopen and InvalidateRenderInfo.
+*
+* RenderManager is made from the plugin's shared client context. It only
+* reads (and pumps) that context when it has to sample the head pose itself,
+* so every render params the present passes carry the head pose instead, see
+* SetRenderHeadPose: querying render infos and presenting never touch the
+* context, and take no lock at all. Only creating and destroying the
+* RenderManager do, under the context's mutex. The state and the render
+* target size can be read from any thread without locking.
+*/
 template<class TGraphicsDevice>
 class FOSVRCustomPresent : public FRHICustomPresent
 {
 public:
     FTexture2DRHIRef mRenderTexture;
 
-    FOSVRCustomPresent(OSVR_ClientContext clientContext) :
-        FRHICustomPresent(nullptr)
+    FOSVRCustomPresent(TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> clientContext) :
+        FRHICustomPresent(nullptr),
+        mSharedClientContext(clientContext)
     {
-        mClientContext = osvrClientInit("com.osvr.unreal.plugin.FOSVRCustomPresent");
+        osvrPose3SetIdentity(&mRenderHeadPose);
+        mSharedClientContext->Register(TEXT("FOSVRCustomPresent"));
     }
 
     virtual ~FOSVRCustomPresent() {
-        if (mClientContext) {
-            osvrClientShutdown(mClientContext);
+        if (mOpenTask.IsValid()) {
+            mOpenTask.Wait();
         }
-
         if (mRenderManager) {
-            osvrDestroyRenderManager(mRenderManager);
+            FOSVRCustomPresent::DestroyRenderManagerImpl(mRenderManager);
         }
+        mSharedClientContext->Unregister(TEXT("FOSVRCustomPresent"));
     }
 
     // virtual methods from FRHICustomPresent
@@ -50,57 +109,363 @@ public:
 
     virtual bool Present(int32 &inOutSyncInterval) override {
         check(IsInRenderingThread());
-        FScopeLock lock(&mOSVRMutex);
-        InitializeImpl();
-        FinishRendering();
+        SCOPE_CYCLE_COUNTER(STAT_OSVRPresent);
+        if (!IsInitialized()) {
+            // still opening, or lost: the mirror window is all there is
+            return true;
+        }
+        // no lock: RenderManager gets the head pose with the render params, see the class comment
+        if (osvrRenderManagerGetDoingOkay(mRenderManager) == OSVR_RETURN_FAILURE || !FinishRendering()) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Presenting to RenderManager failed. The display may have been unplugged or taken over; reopening it later."));
+            EnterLost_RenderThread();
+            return true;
+        }
+        if (GetState() == PRESENT_BUFFERS_REGISTERED) {
+            SetState(PRESENT_PRESENTING);
+        }
         return true;
     }
 
-    // implement this in the sub-class
-    virtual bool Initialize() {
-        FScopeLock lock(&mOSVRMutex);
-        return InitializeImpl();
+    /**
+    * Drives the lifecycle from the game thread: starts opening the display
+    * when there's no RenderManager yet, or when the last one was lost and the
+    * retry delay is over. Cheap; call once per frame.
+    */
+    virtual void UpdateLifecycle() {
+        check(IsInGameThread());
+        const EOSVRPresentState state = GetState();
+        if ((state != PRESENT_CREATED && state != PRESENT_LOST) || mPendingReopens > 0) {
+            return;
+        }
+        {
+            FOSVRScopeLock lock(&mOSVRMutex, GET_STATID(STAT_OSVRPresentLockWait), GET_STATID(STAT_OSVRPresentLockHeld));
+            if (FPlatformTime::Seconds() < mNextOpenAttemptTime) {
+                return;
+            }
+        }
+        if (mOpenTask.IsValid()) {
+            // finished, since the state isn't PRESENT_OPENING
+            mOpenTask.Wait();
+        }
+
+        SetState(PRESENT_OPENING);
+        FOpenPromiseRef promise = MakeShareable(new TPromise<bool>());
+        mOpenTask = promise->GetFuture();
+        StartOpenDisplay(promise);
     }
 
-    virtual bool IsInitialized() {
-        return mInitialized;
+    /**
+    * Has the render thread drop the RenderManager, which is bound to the
+    * current client context, and reopen the display right away on the next
+    * UpdateLifecycle after that. Called from the game thread before the
+    * context is swapped for a reconnect; the old context is shut down on the
+    * render thread after the command queued here. The render target is kept.
+    */
+    virtual void Reopen() {
+        check(IsInGameThread());
+        // Only the render thread drops an open display, see the class comment.
+        // An open on the render thread is a command queued before this one;
+        // no other open starts until this one has run.
+        FPlatformAtomics::InterlockedIncrement(&mPendingReopens);
+        ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRReopenDisplay,
+            TRefCountPtr<FOSVRCustomPresent>, present, this,
+            {
+                {
+                    FOSVRScopeLock lock(&present->mOSVRMutex, GET_STATID(STAT_OSVRPresentLockWait), GET_STATID(STAT_OSVRPresentLockHeld));
+                    present->EnterLost();
+                    present->mOpenRetryInterval = 0.0;
+                    present->mNextOpenAttemptTime = 0.0;
+                }
+                FPlatformAtomics::InterlockedDecrement(&present->mPendingReopens);
+            });
+    }
+
+    virtual EOSVRPresentState GetState() const {
+        return static_cast<EOSVRPresentState>(mState);
+    }
+
+    /** @return True if the display is open, i.e. sizes are known and frames can be presented. */
+    virtual bool IsInitialized() const {
+        const EOSVRPresentState state = GetState();
+        return state == PRESENT_OPENED || state == PRESENT_BUFFERS_REGISTERED || state == PRESENT_PRESENTING;
+    }
+
+    /**
+    * @return True if the display is open but presents from another texture
+    * than ViewportTarget (none yet, or the warm-up one), so the viewport's
+    * render target has to be reallocated.
+    */
+    virtual bool NeedsRenderTarget(const FTexture2DRHIRef& ViewportTarget) const {
+        return IsInitialized() && (!IsValidRef(mRenderTexture) || mRenderTexture != ViewportTarget);
+    }
+
+    /**
+    * First half of the warm-up: allocates (or keeps) the render target at the
+    * size RenderManager asks for, with what FSceneViewport will ask for, so
+    * the viewport gets this very texture later on.
+    *
+    * @return The render target, invalid if the display isn't open.
+    */
+    virtual FTexture2DRHIRef AllocateWarmUpTarget_RenderThread() {
+        check(IsInRenderingThread());
+        uint32 sizeX = 0, sizeY = 0;
+        FTexture2DRHIRef targetableTexture, shaderResourceTexture;
+        if (!IsInitialized() || !GetRenderTargetSize(sizeX, sizeY)
+            || !AllocateRenderTargetTexture(0, sizeX, sizeY, PF_B8G8R8A8, 1, TexCreate_None, TexCreate_RenderTargetable, targetableTexture, shaderResourceTexture)) {
+            return FTexture2DRHIRef();
+        }
+        return targetableTexture;
+    }
+
+    /**
+    * Second half of the warm-up: registers the render target with
+    * RenderManager and presents it once. The caller has drawn (black) into it.
+    *
+    * @return True if the frame was presented.
+    */
+    virtual bool PresentWarmUpFrame_RenderThread() {
+        check(IsInRenderingThread());
+        if (!IsInitialized()) {
+            return false;
+        }
+        // no frame was rendered; it goes out with the last head pose set
+        if (!UpdateRenderBuffers() || !FinishRendering()) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Presenting the warm-up frame to RenderManager failed; reopening the display later."));
+            EnterLost_RenderThread();
+            return false;
+        }
+        SetState(PRESENT_PRESENTING);
+        return true;
     }
 
     virtual bool UpdateViewport(const FViewport& InViewport, class FRHIViewport* InViewportRHI) = 0;
 
-    // RenderManager normalizes displays a bit. We create the render target assuming horizontal side-by-side.
-    // RenderManager then rotates that render texture if needed for vertical side-by-side displays.
-    virtual bool CalculateRenderTargetSize(uint32& InOutSizeX, uint32& InOutSizeY) {
-        FScopeLock lock(&mOSVRMutex);
-        return CalculateRenderTargetSizeImpl(InOutSizeX, InOutSizeY);
+    /**
+    * Sets the head pose, in OSVR room space, that the next presented frame was
+    * rendered with, so RenderManager's timewarp corrects against that pose
+    * instead of sampling its own from the client context. Pass nullptr if the
+    * pose isn't known; the last one set (identity at first) is kept then.
+    */
+    virtual void SetRenderHeadPose(const OSVR_Pose3* pose) {
+        check(IsInRenderingThread());
+        if (pose) {
+            mRenderHeadPose = *pose;
+        }
+    }
+
+    /**
+    * Gets the render target size RenderManager asked for when the render infos
+    * were last queried. Doesn't lock or call into RenderManager, so it's cheap
+    * enough for per-eye view setup. Any thread.
+    *
+    * RenderManager normalizes displays a bit. We create the render target assuming horizontal side-by-side.
+    * RenderManager then rotates that render texture if needed for vertical side-by-side displays.
+    *
+    * @return False, leaving the size alone, while the display isn't open.
+    */
+    bool GetRenderTargetSize(uint32& InOutSizeX, uint32& InOutSizeY) const {
+        const FIntPoint size = mRenderConfig.Read().RenderTargetSize;
+        if (size.X <= 0 || size.Y <= 0) {
+            return false;
+        }
+        InOutSizeX = size.X;
+        InOutSizeY = size.Y;
+        return true;
+    }
+
+    /**
+    * Drops the cached render infos and target size and queries them from
+    * RenderManager again. They're otherwise only queried when the display
+    * opens, so call this when they may have changed: a new display config or
+    * IPD, or an explicit resize (EnableStereo resizing the window or the
+    * viewport). The new size is visible from the next frame on.
+    */
+    virtual void InvalidateRenderInfo() {
+        ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRInvalidateRenderInfo,
+            TRefCountPtr<FOSVRCustomPresent>, present, this,
+            {
+                if (present->IsInitialized()) {
+                    present->UpdateRenderInfo();
+                }
+            });
     }
 
     virtual bool AllocateRenderTargetTexture(uint32 index, uint32 sizeX, uint32 sizeY, uint8 format, uint32 numMips, uint32 flags, uint32 targetableTextureFlags, FTexture2DRHIRef& outTargetableTexture, FTexture2DRHIRef& outShaderResourceTexture, uint32 numSamples = 1) = 0;
 
 protected:
+    /**
+    * Serializes the lifecycle transitions, opening the display and losing it.
+    * Never taken while presenting. Lock order: mOSVRMutex, then the client context's mutex
+    */
     FCriticalSection mOSVRMutex;
+
+    // Present state, render thread only once the display is open; see the class comment.
     std::vector<OSVR_ViewportDescription> mViewportDescriptions;
     OSVR_RenderParams mRenderParams;
 
+    /**
+    * Cached by UpdateRenderInfo, along with the API specific render infos.
+    * Written by whoever owns the present state, readable from any thread.
+    */
+    TOSVRSeqLock<FOSVRRenderConfig> mRenderConfig;
+
+    /** See SetRenderHeadPose. mRenderParams always points to it. */
+    OSVR_PoseState mRenderHeadPose;
+
     bool mRenderBuffersNeedToUpdate = true;
-    bool mInitialized = false;
-    OSVR_ClientContext mClientContext = nullptr;
+    /** The plugin's client context, registered with for the lifetime of the present */
+    TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> mSharedClientContext;
     OSVR_RenderManager mRenderManager = nullptr;
 
-    virtual bool CalculateRenderTargetSizeImpl(uint32& InOutSizeX, uint32& InOutSizeY) = 0;
+    /** An EOSVRPresentState, readable from any thread. See the class comment for who changes it when. */
+    volatile int32 mState = PRESENT_CREATED;
+    /** When UpdateLifecycle may open the display again, and the delay it grows by. Guarded by mOSVRMutex */
+    double mNextOpenAttemptTime = 0.0;
+    double mOpenRetryInterval = 0.0;
+    TFuture<bool> mOpenTask;
+    typedef TSharedRef<TPromise<bool>, ESPMode::ThreadSafe> FOpenPromiseRef;
+    /** Reopen commands queued and not run yet; UpdateLifecycle doesn't open meanwhile */
+    volatile int32 mPendingReopens = 0;
+
+    void SetState(EOSVRPresentState state) {
+        FPlatformAtomics::InterlockedExchange(&mState, state);
+    }
+
+    /**
+    * @return True if mRenderTexture can be handed out again for a viewport
+    * asking for a target like this (the next Play-In-Editor session, or
+    * stereo turned back on), so RenderManager keeps presenting from it.
+    */
+    bool CanReuseRenderTexture(uint32 sizeX, uint32 sizeY, uint8 format, uint32 numMips, uint32 numSamples) const {
+        return IsValidRef(mRenderTexture) && mRenderTexture->GetSizeX() == sizeX && mRenderTexture->GetSizeY() == sizeY
+            && mRenderTexture->GetFormat() == EPixelFormat(format) && mRenderTexture->GetNumMips() == numMips
+            && mRenderTexture->GetNumSamples() == numSamples;
+    }
+
+    /**
+    * Has OpenDisplay run, and its result set on Promise. Game thread. By
+    * default it's a render command: the OpenGL present needs the engine's
+    * context, which is only current on the render thread. The reference keeps
+    * the present alive until the command has run, so whoever waits for
+    * mOpenTask never waits on a command that can't run.
+    */
+    virtual void StartOpenDisplay(const FOpenPromiseRef& Promise) {
+        ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(OSVROpenDisplay,
+            TRefCountPtr<FOSVRCustomPresent>, present, this,
+            FOpenPromiseRef, promise, Promise,
+            {
+                promise->SetValue(present->OpenDisplay());
+            });
+    }
+
+    /**
+    * Runs where StartOpenDisplay put it. Nothing else touches the
+    * RenderManager while the state is PRESENT_OPENING, so the locks are only
+    * held where needed.
+    */
+    bool OpenDisplay() {
+        bool bOpened;
+        {
+            // creating the RenderManager reads the display config from the context
+            FOSVRContextScopeLock contextLock(&mSharedClientContext->GetMutex());
+            bOpened = CreateRenderManagerImpl();
+        }
+        bOpened = bOpened && OpenDisplayImpl();
+
+        FOSVRScopeLock lock(&mOSVRMutex, GET_STATID(STAT_OSVRPresentLockWait), GET_STATID(STAT_OSVRPresentLockHeld));
+        if (!bOpened) {
+            EnterLost();
+            return false;
+        }
+        mOpenRetryInterval = 0.0;
+        mRenderBuffersNeedToUpdate = true;
+        SetState(PRESENT_OPENED);
+        UpdateRenderInfo();
+        UE_LOG(FOSVRCustomPresentLog, Log, TEXT("RenderManager display opened."));
+        return true;
+    }
+
+    /**
+    * Drops the RenderManager and schedules the next open attempt. The render
+    * target is kept and registered again with the next RenderManager. Call with
+    * mOSVRMutex held, on the render thread (see EnterLost_RenderThread) or
+    * from OpenDisplay.
+    */
+    void EnterLost() {
+        if (mRenderManager) {
+            DestroyRenderManagerImpl(mRenderManager);
+            mRenderManager = nullptr;
+        }
+        ResetRenderManagerImpl();
+        mRenderConfig.Write(FOSVRRenderConfig());
+        mRenderBuffersNeedToUpdate = true;
+
+        // doubles with every failed attempt, between these
+        const double minOpenRetrySeconds = 0.1;
+        const double maxOpenRetrySeconds = 5.0;
+        mOpenRetryInterval = FMath::Clamp(mOpenRetryInterval * 2.0, minOpenRetrySeconds, maxOpenRetrySeconds);
+        mNextOpenAttemptTime = FPlatformTime::Seconds() + mOpenRetryInterval;
+        SetState(PRESENT_LOST);
+    }
+
+    /** EnterLost for the render thread, which otherwise goes without mOSVRMutex. */
+    void EnterLost_RenderThread() {
+        check(IsInRenderingThread());
+        FOSVRScopeLock lock(&mOSVRMutex, GET_STATID(STAT_OSVRPresentLockWait), GET_STATID(STAT_OSVRPresentLockHeld));
+        EnterLost();
+    }
+
+    /**
+    * Queries the render infos and caches them, with the target size they add
+    * up to. Call on the render thread with
+    * the display open, or from OpenDisplay.
+    */
+    void UpdateRenderInfo() {
+        FOSVRRenderConfig config;
+        uint32 sizeX = 0, sizeY = 0;
+        if (QueryRenderInfoImpl(sizeX, sizeY)) {
+            config.RenderTargetSize = FIntPoint(sizeX, sizeY);
+        }
+        mRenderConfig.Write(config);
+    }
+
+    /**
+    * Gets fresh default render params, pointed at mRenderHeadPose, and the API
+    * specific render infos for them from RenderManager, and computes the
+    * render target size.
+    */
+    virtual bool QueryRenderInfoImpl(uint32& OutSizeX, uint32& OutSizeY) = 0;
+
+    /**
+    * Creates mRenderManager, from the shared client context, and the API
+    * specific handle. Called with the client context's mutex held.
+    */
+    virtual bool CreateRenderManagerImpl() = 0;
+
+    /** Opens the display of the RenderManager created by CreateRenderManagerImpl. */
+    virtual bool OpenDisplayImpl() = 0;
+
+    /** Destroys a RenderManager, which frees what it got from the client context, so under its mutex. */
+    virtual void DestroyRenderManagerImpl(OSVR_RenderManager renderManager) {
+        FOSVRContextScopeLock contextLock(&mSharedClientContext->GetMutex());
+        osvrDestroyRenderManager(renderManager);
+    }
 
-    virtual bool InitializeImpl() = 0;
+    /** Forgets the API specific state of a RenderManager that's been destroyed. */
+    virtual void ResetRenderManagerImpl() = 0;
 
     virtual TGraphicsDevice* GetGraphicsDevice() {
         auto ret = RHIGetNativeDevice();
         return reinterpret_cast<TGraphicsDevice*>(ret);
     }
 
-    virtual void FinishRendering() = 0;
+    /** @return False if RenderManager failed to present the frame. */
+    virtual bool FinishRendering() = 0;
 
     // abstract methods, implement in DirectX/OpenGL specific subclasses
     virtual std::string GetGraphicsLibraryName() = 0;
     virtual bool ShouldFlipY() = 0;
-    virtual void UpdateRenderBuffers() = 0;
+    /** Registers the render buffers with RenderManager if needed. @return False if that failed. */
+    virtual bool UpdateRenderBuffers() = 0;
 };
 
@@ -20,21 +20,116 @@
 
 #include "IOSVR.h"
 #include "OSVRCustomPresent.h"
+#include "OSVRDisplayThread.h"
 
 #include "AllowWindowsPlatformTypes.h"
 #include <osvr/RenderKit/RenderManagerD3D11C.h>
 #include "HideWindowsPlatformTypes.h"
 #include "Runtime/Windows/D3D11RHI/Private/D3D11RHIPrivate.h"
 
-class FCurrentCustomPresent : public FOSVRCustomPresent<ID3D11Device>
+/**
+* A render target made of one D3D11 texture per swap chain slot. The engine
+* only ever sees this one RHI texture; SwitchToSlot points it at another
+* slot's texture and views, so the next frame is rendered into that slot
+* while RenderManager may still be reading the previous one.
+*/
+class FOSVRD3D11TextureSet : public FD3D11Texture2D
 {
 public:
-    FCurrentCustomPresent(OSVR_ClientContext clientContext) :
-        FOSVRCustomPresent(clientContext)
+    struct FSlot
+    {
+        TRefCountPtr<ID3D11Texture2D> Texture;
+        TRefCountPtr<ID3D11RenderTargetView> RenderTargetView;
+        TRefCountPtr<ID3D11ShaderResourceView> ShaderResourceView;
+        /** Signaled once the GPU is done with the last present from this slot */
+        TRefCountPtr<ID3D11Query> Fence;
+        bool bFenceIssued = false;
+    };
+
+    FOSVRD3D11TextureSet(FD3D11DynamicRHI* d3d11RHI, const TArray<FSlot>& slots, uint32 sizeX, uint32 sizeY, uint32 numMips, uint32 numSamples, EPixelFormat format, uint32 flags) :
+        FD3D11Texture2D(d3d11RHI, slots[0].Texture, slots[0].ShaderResourceView, false,
+            1, MakeRenderTargetViews(slots[0]), nullptr,
+            sizeX, sizeY, 0, numMips, numSamples, format,
+            false, flags, false, FClearValueBinding::Black),
+        Slots(slots)
     {}
 
+    int32 GetNumSlots() const {
+        return Slots.Num();
+    }
+
+    int32 GetCurrentSlot() const {
+        return CurrentSlot;
+    }
+
+    FSlot& GetSlot(int32 index) {
+        return Slots[index];
+    }
+
+    /** Render thread only, between frames. */
+    void SwitchToSlot(int32 index) {
+        check(IsInRenderingThread());
+        CurrentSlot = index;
+        const FSlot& slot = Slots[index];
+        Resource = slot.Texture;
+        ShaderResourceView = slot.ShaderResourceView;
+        RenderTargetViews = MakeRenderTargetViews(slot);
+    }
+
+private:
+    static TArray<TRefCountPtr<ID3D11RenderTargetView>> MakeRenderTargetViews(const FSlot& slot) {
+        TArray<TRefCountPtr<ID3D11RenderTargetView>> views;
+        views.Add(slot.RenderTargetView);
+        return views;
+    }
+
+    TArray<FSlot> Slots;
+    int32 CurrentSlot = 0;
+};
+
+/**
+* Presents through RenderManager's D3D11 API. RenderManager is created, opened
+* and destroyed on a display thread of its own (see FOSVRDisplayThread), and
+* presents from the render thread. Opening only creates resources on the
+* device, which is free-threaded; the engine's immediate context is only used
+* when presenting.
+*/
+class FCurrentCustomPresent : public FOSVRCustomPresent<ID3D11Device>
+{
+public:
+    FCurrentCustomPresent(TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> clientContext) :
+        FOSVRCustomPresent(clientContext),
+        mDisplayThread(MakeShareable(new FOSVRDisplayThread()))
+    {
+        if (!mDisplayThread->Start()) {
+            // opens on the render thread then, see StartOpenDisplay
+            mDisplayThread = nullptr;
+        }
+    }
+
+    virtual ~FCurrentCustomPresent() {
+        if (mOpenTask.IsValid()) {
+            mOpenTask.Wait();
+        }
+        // while the display thread is still there to destroy it
+        if (mRenderManager) {
+            DestroyRenderManagerImpl(mRenderManager);
+            mRenderManager = nullptr;
+        }
+        mDisplayThread = nullptr;
+    }
+
+    virtual void Reopen() override {
+        // An open in progress on the display thread isn't ordered with render
+        // commands, so it's waited for. That only happens when the server goes
+        // away while the display is being opened.
+        if (mOpenTask.IsValid()) {
+            mOpenTask.Wait();
+        }
+        FOSVRCustomPresent::Reopen();
+    }
+
     virtual bool UpdateViewport(const FViewport& InViewport, class FRHIViewport* InViewportRHI) override {
-        FScopeLock lock(&mOSVRMutex);
 
         check(IsInGameThread());
         if (!IsInitialized()) {
@@ -57,8 +152,16 @@ public:
     }
 
     virtual bool AllocateRenderTargetTexture(uint32 index, uint32 sizeX, uint32 sizeY, uint8 format, uint32 numMips, uint32 flags, uint32 targetableTextureFlags, FTexture2DRHIRef& outTargetableTexture, FTexture2DRHIRef& outShaderResourceTexture, uint32 numSamples = 1) override {
-        FScopeLock lock(&mOSVRMutex);
+        check(IsInRenderingThread());
+        // registers the render buffers with RenderManager
         if (IsInitialized()) {
+            const int32 numSlots = OSVRGetSwapChainLength();
+            if (CanReuseRenderTexture(sizeX, sizeY, format, numMips, numSamples) && mTextureSet->GetNumSlots() == numSlots) {
+                outTargetableTexture = mRenderTexture;
+                outShaderResourceTexture = mRenderTexture;
+                return true;
+            }
+
             auto d3d11RHI = static_cast<FD3D11DynamicRHI*>(GDynamicRHI);
             auto graphicsDevice = GetGraphicsDevice();
             HRESULT hr;
@@ -68,7 +171,6 @@ public:
             textureDesc.Height = sizeY;
             textureDesc.MipLevels = 1;
             textureDesc.ArraySize = 1;
-            //textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
             textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
             textureDesc.SampleDesc.Count = 1;
             textureDesc.SampleDesc.Quality = 0;
@@ -78,42 +180,12 @@ public:
             textureDesc.CPUAccessFlags = 0;
             textureDesc.MiscFlags = 0;
 
-            ID3D11Texture2D *D3DTexture = nullptr;
-            hr = graphicsDevice->CreateTexture2D(
-                &textureDesc, NULL, &D3DTexture);
-            check(!FAILED(hr));
-
-            SetRenderTargetTexture(D3DTexture);
-
             D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
             memset(&renderTargetViewDesc, 0, sizeof(renderTargetViewDesc));
-            // This must match what was created in the texture to be rendered
-            //renderTargetViewDesc.Format = renderTextureDesc.Format;
             renderTargetViewDesc.Format = textureDesc.Format;
             renderTargetViewDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
             renderTargetViewDesc.Texture2D.MipSlice = 0;
 
-            // Create the render target view.
-            ID3D11RenderTargetView *renderTargetView; //< Pointer to our render target view
-            hr = graphicsDevice->CreateRenderTargetView(
-                RenderTargetTexture, &renderTargetViewDesc, &renderTargetView);
-            check(!FAILED(hr));
-
-            RenderTargetView = renderTargetView;
-
-            ID3D11ShaderResourceView* shaderResourceView = nullptr;
-            bool createdRTVsPerSlice = false;
-            int32 rtvArraySize = 1;
-            TArray<TRefCountPtr<ID3D11RenderTargetView>> renderTargetViews;
-            TRefCountPtr<ID3D11DepthStencilView>* depthStencilViews = nullptr;
-            uint32 sizeZ = 0;
-            EPixelFormat epFormat = EPixelFormat(format);
-            bool cubemap = false;
-            bool pooled = false;
-            // override flags
-            flags = TexCreate_RenderTargetable | TexCreate_ShaderResource;
-
-            renderTargetViews.Add(renderTargetView);
             D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
             memset(&shaderResourceViewDesc, 0, sizeof(shaderResourceViewDesc));
             shaderResourceViewDesc.Format = textureDesc.Format;
@@ -121,19 +193,33 @@ public:
             shaderResourceViewDesc.Texture2D.MipLevels = textureDesc.MipLevels;
             shaderResourceViewDesc.Texture2D.MostDetailedMip = textureDesc.MipLevels - 1;
 
-            hr = graphicsDevice->CreateShaderResourceView(
-                RenderTargetTexture, &shaderResourceViewDesc, &shaderResourceView);
-            check(!FAILED(hr));
+            D3D11_QUERY_DESC fenceDesc;
+            memset(&fenceDesc, 0, sizeof(fenceDesc));
+            fenceDesc.Query = D3D11_QUERY_EVENT;
+
+            // One texture, with its views and a fence, per swap chain slot.
+            TArray<FOSVRD3D11TextureSet::FSlot> slots;
+            for (int32 i = 0; i < numSlots; i++) {
+                FOSVRD3D11TextureSet::FSlot slot;
+                hr = graphicsDevice->CreateTexture2D(&textureDesc, NULL, slot.Texture.GetInitReference());
+                check(!FAILED(hr));
+                hr = graphicsDevice->CreateRenderTargetView(slot.Texture, &renderTargetViewDesc, slot.RenderTargetView.GetInitReference());
+                check(!FAILED(hr));
+                hr = graphicsDevice->CreateShaderResourceView(slot.Texture, &shaderResourceViewDesc, slot.ShaderResourceView.GetInitReference());
+                check(!FAILED(hr));
+                hr = graphicsDevice->CreateQuery(&fenceDesc, slot.Fence.GetInitReference());
+                check(!FAILED(hr));
+                slots.Add(slot);
+            }
 
-            auto targetableTexture = new FD3D11Texture2D(
-                d3d11RHI, D3DTexture, shaderResourceView, createdRTVsPerSlice,
-                rtvArraySize, renderTargetViews, depthStencilViews,
-                textureDesc.Width, textureDesc.Height, sizeZ, numMips, numSamples, epFormat,
-                cubemap, flags, pooled, FClearValueBinding::Black);
+            // override flags
+            flags = TexCreate_RenderTargetable | TexCreate_ShaderResource;
+            mTextureSet = new FOSVRD3D11TextureSet(d3d11RHI, slots, textureDesc.Width, textureDesc.Height,
+                numMips, numSamples, EPixelFormat(format), flags);
 
-            outTargetableTexture = targetableTexture->GetTexture2D();
-            outShaderResourceTexture = targetableTexture->GetTexture2D();
-            mRenderTexture = targetableTexture;
+            outTargetableTexture = mTextureSet->GetTexture2D();
+            outShaderResourceTexture = mTextureSet->GetTexture2D();
+            mRenderTexture = mTextureSet->GetTexture2D();
             mRenderBuffersNeedToUpdate = true;
             UpdateRenderBuffers();
             return true;
@@ -142,20 +228,25 @@ public:
     }
 
 protected:
-    ID3D11Texture2D* RenderTargetTexture = NULL;
-    ID3D11RenderTargetView * RenderTargetView = NULL;
+    /** Where RenderManager is opened and destroyed; null if it couldn't be started */
+    TSharedPtr<FOSVRDisplayThread> mDisplayThread;
+    /** The render target, also in mRenderTexture */
+    TRefCountPtr<FOSVRD3D11TextureSet> mTextureSet;
+    bool mLoggedFenceTimeout = false;
 
+    /** Two buffers (one per eye) per swap chain slot, slot after slot */
     std::vector<OSVR_RenderBufferD3D11> mRenderBuffers;
     std::vector<OSVR_RenderInfoD3D11> mRenderInfos;
     OSVR_RenderManagerD3D11 mRenderManagerD3D11 = nullptr;
 
-    virtual bool CalculateRenderTargetSizeImpl(uint32& InOutSizeX, uint32& InOutSizeY) override {
-        if (InitializeImpl()) {
+    virtual bool QueryRenderInfoImpl(uint32& OutSizeX, uint32& OutSizeY) override {
+        if (IsInitialized()) {
             // Should we create a RenderParams?
             OSVR_ReturnCode rc;
 
             rc = osvrRenderManagerGetDefaultRenderParams(&mRenderParams);
             check(rc == OSVR_RETURN_SUCCESS);
+            mRenderParams.roomFromHeadReplace = &mRenderHeadPose;
 
             OSVR_RenderInfoCount numRenderInfo;
             rc = osvrRenderManagerGetNumRenderInfo(mRenderManager, mRenderParams, &numRenderInfo);
@@ -173,126 +264,188 @@ protected:
             // check some assumptions. Should all be the same height.
             check(mRenderInfos.size() == 2);
             check(mRenderInfos[0].viewport.height == mRenderInfos[1].viewport.height);
-            InOutSizeX = mRenderInfos[0].viewport.width + mRenderInfos[1].viewport.width;
-            InOutSizeY = mRenderInfos[0].viewport.height;
-            check(InOutSizeX != 0 && InOutSizeY != 0);
+            OutSizeX = mRenderInfos[0].viewport.width + mRenderInfos[1].viewport.width;
+            OutSizeY = mRenderInfos[0].viewport.height;
+            check(OutSizeX != 0 && OutSizeY != 0);
             return true;
         }
         return false;
     }
 
-    virtual bool InitializeImpl() override {
-        if (!IsInitialized()) {
-            auto graphicsLibrary = CreateGraphicsLibrary();
-            auto graphicsLibraryName = GetGraphicsLibraryName();
-            OSVR_ReturnCode rc;
-
-            if (!mClientContext) {
-                UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Can't initialize FOSVRCustomPresent without a valid client context"));
-                return false;
-            }
+    virtual bool CreateRenderManagerImpl() override {
+        auto graphicsLibrary = CreateGraphicsLibrary();
+        auto graphicsLibraryName = GetGraphicsLibraryName();
+        OSVR_ReturnCode rc;
 
-            rc = osvrCreateRenderManagerD3D11(mClientContext, graphicsLibraryName.c_str(), graphicsLibrary, &mRenderManager, &mRenderManagerD3D11);
-            if (rc == OSVR_RETURN_FAILURE || !mRenderManager || !mRenderManagerD3D11) {
-                UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrCreateRenderManagerD3D11 call failed, or returned numm renderManager/renderManagerD3D11 instances"));
-                return false;
-            }
+        // the current one, which changes when the server is reconnected to
+        OSVR_ClientContext clientContext = mSharedClientContext->Get();
+        if (!clientContext) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Can't initialize FOSVRCustomPresent without a valid client context"));
+            return false;
+        }
 
-            rc = osvrRenderManagerGetDoingOkay(mRenderManager);
-            if (rc == OSVR_RETURN_FAILURE) {
-                UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerGetDoingOkay call failed. Perhaps there was an error during initialization?"));
-                return false;
-            }
+        rc = osvrCreateRenderManagerD3D11(clientContext, graphicsLibraryName.c_str(), graphicsLibrary, &mRenderManager, &mRenderManagerD3D11);
+        if (rc == OSVR_RETURN_FAILURE || !mRenderManager || !mRenderManagerD3D11) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrCreateRenderManagerD3D11 call failed, or returned numm renderManager/renderManagerD3D11 instances"));
+            return false;
+        }
 
-            OSVR_OpenResultsD3D11 results;
-            rc = osvrRenderManagerOpenDisplayD3D11(mRenderManagerD3D11, &results);
-            if (rc == OSVR_RETURN_FAILURE || results.status == OSVR_OPEN_STATUS_FAILURE) {
-                UE_LOG(FOSVRCustomPresentLog, Warning,
-                    TEXT("osvrRenderManagerOpenDisplayD3D11 call failed, or the result status was OSVR_OPEN_STATUS_FAILURE. Potential causes could be that the display is already open in direct mode with another app, or the display does not support direct mode"));
-                return false;
-            }
+        rc = osvrRenderManagerGetDoingOkay(mRenderManager);
+        if (rc == OSVR_RETURN_FAILURE) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerGetDoingOkay call failed. Perhaps there was an error during initialization?"));
+            return false;
+        }
+        return true;
+    }
 
-            // @todo: create the textures?
+    virtual void StartOpenDisplay(const FOpenPromiseRef& Promise) override {
+        if (!mDisplayThread.IsValid()) {
+            FOSVRCustomPresent::StartOpenDisplay(Promise);
+            return;
+        }
+        // the destructor waits for mOpenTask, so the present outlives the job
+        FOpenPromiseRef promise = Promise;
+        mDisplayThread->Queue([this, promise]() {
+            promise->SetValue(OpenDisplay());
+        });
+    }
 
-            mInitialized = true;
+    virtual bool OpenDisplayImpl() override {
+        // On the display thread: in extended mode RenderManager's window belongs to it.
+        OSVR_OpenResultsD3D11 results;
+        OSVR_ReturnCode rc = osvrRenderManagerOpenDisplayD3D11(mRenderManagerD3D11, &results);
+        if (rc == OSVR_RETURN_FAILURE || results.status == OSVR_OPEN_STATUS_FAILURE) {
+            UE_LOG(FOSVRCustomPresentLog, Warning,
+                TEXT("osvrRenderManagerOpenDisplayD3D11 call failed, or the result status was OSVR_OPEN_STATUS_FAILURE. Potential causes could be that the display is already open in direct mode with another app, or the display does not support direct mode"));
+            return false;
         }
         return true;
     }
 
-    virtual void FinishRendering() override
+    virtual void DestroyRenderManagerImpl(OSVR_RenderManager renderManager) override {
+        if (!mDisplayThread.IsValid() || mDisplayThread->IsCurrentThread()) {
+            FOSVRCustomPresent::DestroyRenderManagerImpl(renderManager);
+            return;
+        }
+        // Its window, in extended mode, can only be destroyed by the display
+        // thread. Waited for, since the client context it was made from may be
+        // shut down right after; no open is in progress whenever this is called.
+        FEvent* destroyed = FPlatformProcess::GetSynchEventFromPool();
+        mDisplayThread->Queue([this, renderManager, destroyed]() {
+            FOSVRCustomPresent::DestroyRenderManagerImpl(renderManager);
+            destroyed->Trigger();
+        });
+        destroyed->Wait();
+        FPlatformProcess::ReturnSynchEventToPool(destroyed);
+    }
+
+    virtual void ResetRenderManagerImpl() override {
+        mRenderManagerD3D11 = nullptr;
+        mRenderBuffers.clear();
+        mRenderInfos.clear();
+    }
+
+    virtual bool FinishRendering() override
     {
         check(IsInitialized());
-        UpdateRenderBuffers();
+        if (!IsValidRef(mTextureSet)) {
+            // the display opened after the viewport was set up; nothing to present until it's reallocated
+            return true;
+        }
+        if (!UpdateRenderBuffers()) {
+            return false;
+        }
         // all of the render manager samples keep the flipY at the default false,
         // for both OpenGL and DirectX. Is this even needed anymore?
         OSVR_ReturnCode rc;
+
+        // The eye poses in the render infos are what timewarp corrects against,
+        // so get them again for the head pose the frame was actually rendered
+        // with (mRenderParams points to it). Only the poses change between
+        // frames; the viewports stay as cached.
+        for (size_t i = 0; i < mRenderInfos.size(); i++) {
+            rc = osvrRenderManagerGetRenderInfoD3D11(mRenderManagerD3D11, i, mRenderParams, &mRenderInfos[i]);
+            check(rc == OSVR_RETURN_SUCCESS);
+        }
+
         OSVR_RenderManagerPresentState presentState;
         rc = osvrRenderManagerStartPresentRenderBuffers(&presentState);
         check(rc == OSVR_RETURN_SUCCESS);
-        check(mRenderBuffers.size() == mRenderInfos.size() && mRenderBuffers.size() == mViewportDescriptions.size());
-        for (size_t i = 0; i < mRenderBuffers.size(); i++) {
-            rc = osvrRenderManagerPresentRenderBufferD3D11(presentState, mRenderBuffers[i], mRenderInfos[i], mViewportDescriptions[i]);
-            check(rc == OSVR_RETURN_SUCCESS);
+        // the buffers of the slot this frame was rendered into
+        const size_t firstBuffer = mTextureSet->GetCurrentSlot() * mRenderInfos.size();
+        check(mRenderBuffers.size() == mRenderInfos.size() * mTextureSet->GetNumSlots() && mRenderInfos.size() == mViewportDescriptions.size());
+        bool bPresented = true;
+        for (size_t i = 0; i < mRenderInfos.size(); i++) {
+            rc = osvrRenderManagerPresentRenderBufferD3D11(presentState, mRenderBuffers[firstBuffer + i], mRenderInfos[i], mViewportDescriptions[i]);
+            bPresented = bPresented && rc == OSVR_RETURN_SUCCESS;
         }
         rc = osvrRenderManagerFinishPresentRenderBuffers(mRenderManager, presentState, mRenderParams, ShouldFlipY() ? OSVR_TRUE : OSVR_FALSE);
-        check(rc == OSVR_RETURN_SUCCESS);
+        if (!bPresented || rc != OSVR_RETURN_SUCCESS) {
+            return false;
+        }
+        AdvanceSwapChain();
+        return true;
     }
 
-    void SetRenderTargetTexture(ID3D11Texture2D* renderTargetTexture) {
-        if (RenderTargetTexture != nullptr && RenderTargetTexture != renderTargetTexture)
-        {
-            // @todo: testing if this is causing problems later on.
-            //RenderTargetTexture->Release();
+    /**
+    * Fences the slot just presented, once RenderManager's reads of it are
+    * queued, and moves the render target on to the next slot, waiting for
+    * RenderManager to be done with that one first. With a single slot, the
+    * engine renders into the texture RenderManager reads, and D3D11
+    * serializes the two.
+    */
+    void AdvanceSwapChain() {
+        const int32 numSlots = mTextureSet->GetNumSlots();
+        if (numSlots < 2) {
+            return;
+        }
+        ID3D11DeviceContext* context = static_cast<FD3D11DynamicRHI*>(GDynamicRHI)->GetDeviceContext();
+        FOSVRD3D11TextureSet::FSlot& presented = mTextureSet->GetSlot(mTextureSet->GetCurrentSlot());
+        context->End(presented.Fence);
+        presented.bFenceIssued = true;
+
+        const int32 nextSlot = (mTextureSet->GetCurrentSlot() + 1) % numSlots;
+        FOSVRD3D11TextureSet::FSlot& next = mTextureSet->GetSlot(nextSlot);
+        if (next.bFenceIssued) {
+            // Only waits when the GPU is more than numSlots - 1 presents behind.
+            // Bounded, so a lost device can't hang the render thread.
+            const double maxFenceWaitSeconds = 0.1;
+            const double waitEnd = FPlatformTime::Seconds() + maxFenceWaitSeconds;
+            BOOL bDone = FALSE;
+            while (context->GetData(next.Fence, &bDone, sizeof(bDone), 0) == S_FALSE) {
+                if (FPlatformTime::Seconds() > waitEnd) {
+                    if (!mLoggedFenceTimeout) {
+                        UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Timed out waiting for RenderManager to finish reading swap chain slot %d."), nextSlot);
+                        mLoggedFenceTimeout = true;
+                    }
+                    break;
+                }
+                FPlatformProcess::Sleep(0.0f);
+            }
+            next.bFenceIssued = false;
         }
-        RenderTargetTexture = renderTargetTexture;
-        RenderTargetTexture->AddRef();
+        mTextureSet->SwitchToSlot(nextSlot);
     }
 
-    virtual void UpdateRenderBuffers() override {
+    virtual bool UpdateRenderBuffers() override {
         HRESULT hr;
 
         check(IsInitialized());
-        if (mRenderBuffersNeedToUpdate) {
-            uint32 width;
-            uint32 height;
-            // @todo: can't call this here, we're in the wrong thread.
-            CalculateRenderTargetSizeImpl(width, height);
-
-            //check(mRenderTexture);
-            //SetRenderTargetTexture(reinterpret_cast<ID3D11Texture2D*>(mRenderTexture->GetNativeResource()));
-            check(RenderTargetTexture);
-
-            D3D11_TEXTURE2D_DESC renderTextureDesc;
-            RenderTargetTexture->GetDesc(&renderTextureDesc);
-
-            auto graphicsDevice = GetGraphicsDevice();
-
-            //D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
-            //memset(&renderTargetViewDesc, 0, sizeof(renderTargetViewDesc));
-            //// This must match what was created in the texture to be rendered
-            ////renderTargetViewDesc.Format = renderTextureDesc.Format;
-            //renderTargetViewDesc.Format = renderTextureDesc.Format;
-            //renderTargetViewDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-            //renderTargetViewDesc.Texture2D.MipSlice = 0;
-
-            //// Create the render target view.
-            //ID3D11RenderTargetView *renderTargetView; //< Pointer to our render target view
-            //hr = graphicsDevice->CreateRenderTargetView(
-            //    RenderTargetTexture, &renderTargetViewDesc, &renderTargetView);
-            //check(!FAILED(hr));
-
-
+        if (mRenderBuffersNeedToUpdate && IsValidRef(mTextureSet)) {
             mRenderBuffers.clear();
 
-            // Adding two RenderBuffers, but they both point to the same D3D11 texture target
-            for (int i = 0; i < 2; i++) {
-                OSVR_RenderBufferD3D11 buffer;
-                buffer.colorBuffer = RenderTargetTexture;
-                //buffer.colorBufferView = renderTargetView;
-                buffer.colorBufferView = RenderTargetView;
-                //buffer.depthStencilBuffer = ???;
-                //buffer.depthStencilView = ???;
-                mRenderBuffers.push_back(buffer);
+            // Every slot is registered up front. Each gets two RenderBuffers,
+            // one per eye, both pointing to the slot's texture.
+            for (int32 slot = 0; slot < mTextureSet->GetNumSlots(); slot++) {
+                const FOSVRD3D11TextureSet::FSlot& textures = mTextureSet->GetSlot(slot);
+                for (int i = 0; i < 2; i++) {
+                    OSVR_RenderBufferD3D11 buffer;
+                    buffer.colorBuffer = textures.Texture;
+                    buffer.colorBufferView = textures.RenderTargetView;
+                    //buffer.depthStencilBuffer = ???;
+                    //buffer.depthStencilView = ???;
+                    mRenderBuffers.push_back(buffer);
+                }
             }
 
             // We need to register these new buffers.
@@ -310,7 +463,10 @@ protected:
                 }
 
                 hr = osvrRenderManagerFinishRegisterRenderBuffers(mRenderManager, state, false);
-                check(hr == OSVR_RETURN_SUCCESS);
+                if (hr != OSVR_RETURN_SUCCESS) {
+                    UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerFinishRegisterRenderBuffers call failed."));
+                    return false;
+                }
             }
 
             // Now specify the viewports for each.
@@ -331,7 +487,11 @@ protected:
             mViewportDescriptions.push_back(rightEye);
 
             mRenderBuffersNeedToUpdate = false;
+            if (GetState() == PRESENT_OPENED) {
+                SetState(PRESENT_BUFFERS_REGISTERED);
+            }
         }
+        return true;
     }
 
     virtual OSVR_GraphicsLibraryD3D11 CreateGraphicsLibrary() {
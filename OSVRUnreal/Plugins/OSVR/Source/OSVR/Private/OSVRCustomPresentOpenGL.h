@@ -14,30 +14,431 @@
 // limitations under the License.
 //
 
+
 #pragma once
 
 #if !PLATFORM_WINDOWS
+
 #include "IOSVR.h"
+#include "OSVRCustomPresent.h"
+
 #include <osvr/RenderKit/RenderManagerOpenGLC.h>
+#include "OpenGLDrvPrivate.h"
+
+/**
+* Saves the GL state RenderManager may change while presenting, and restores
+* it when going out of scope, so the OpenGL RHI's state cache stays right.
+*/
+class FOSVRScopedGLState
+{
+public:
+    FOSVRScopedGLState() {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &mDrawFramebuffer);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &mReadFramebuffer);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &mProgram);
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &mVertexArray);
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &mArrayBuffer);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &mActiveTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &mTexture0);
+        glGetIntegerv(GL_SAMPLER_BINDING, &mSampler0);
+        glGetIntegerv(GL_VIEWPORT, mViewport);
+        glGetIntegerv(GL_SCISSOR_BOX, mScissorBox);
+        glGetBooleanv(GL_COLOR_WRITEMASK, mColorMask);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &mDepthMask);
+        for (int32 i = 0; i < NumCapabilities; i++) {
+            mEnabled[i] = glIsEnabled(GetCapability(i));
+        }
+    }
+
+    ~FOSVRScopedGLState() {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mDrawFramebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mReadFramebuffer);
+        glUseProgram(mProgram);
+        glBindVertexArray(mVertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, mArrayBuffer);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, mTexture0);
+        glBindSampler(0, mSampler0);
+        glActiveTexture(mActiveTexture);
+        glViewport(mViewport[0], mViewport[1], mViewport[2], mViewport[3]);
+        glScissor(mScissorBox[0], mScissorBox[1], mScissorBox[2], mScissorBox[3]);
+        glColorMask(mColorMask[0], mColorMask[1], mColorMask[2], mColorMask[3]);
+        glDepthMask(mDepthMask);
+        for (int32 i = 0; i < NumCapabilities; i++) {
+            if (mEnabled[i]) {
+                glEnable(GetCapability(i));
+            } else {
+                glDisable(GetCapability(i));
+            }
+        }
+    }
 
-// @todo OpenGL implementation
-class FCurrentCustomPresent : public FOSVRCustomPresent< ? >
+private:
+    enum { NumCapabilities = 6 };
+
+    static GLenum GetCapability(int32 index) {
+        static const GLenum capabilities[NumCapabilities] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_FRAMEBUFFER_SRGB };
+        return capabilities[index];
+    }
+
+    GLint mDrawFramebuffer, mReadFramebuffer, mProgram, mVertexArray, mArrayBuffer, mActiveTexture, mTexture0, mSampler0;
+    GLint mViewport[4], mScissorBox[4];
+    GLboolean mColorMask[4], mDepthMask;
+    GLboolean mEnabled[NumCapabilities];
+};
+
+/**
+* Presents through RenderManager's OpenGL API. RenderManager is given the
+* engine's window and GL context instead of making its own (see
+* CreateGraphicsLibrary), so the render target the engine renders into can be
+* handed to it as is. Its distortion pass draws into the viewport's back
+* buffer, a texture the engine blits to the window after Present, through a
+* framebuffer of our own (see ToolkitMakeCurrent): framebuffer 0 of the render
+* thread's context is not the viewport's window. Everything touching
+* RenderManager runs on the render thread, where the engine's context is
+* current.
+*/
+class FCurrentCustomPresent : public FOSVRCustomPresent<void>
 {
+public:
+    FCurrentCustomPresent(TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> clientContext) :
+        FOSVRCustomPresent(clientContext)
+    {
+        FMemory::Memzero(mToolkit);
+        mToolkit.size = sizeof(mToolkit);
+        mToolkit.data = this;
+        mToolkit.create = &ToolkitCreate;
+        mToolkit.destroy = &ToolkitDestroy;
+        mToolkit.addOpenGLContext = &ToolkitAddOpenGLContext;
+        mToolkit.removeOpenGLContexts = &ToolkitRemoveOpenGLContexts;
+        mToolkit.makeCurrent = &ToolkitMakeCurrent;
+        mToolkit.swapBuffers = &ToolkitSwapBuffers;
+        mToolkit.setVerticalSync = &ToolkitSetVerticalSync;
+        mToolkit.handleEvents = &ToolkitHandleEvents;
+    }
+
+    virtual ~FCurrentCustomPresent() {
+        if (mOpenTask.IsValid()) {
+            mOpenTask.Wait();
+        }
+        // the base destructor would destroy it off the render thread
+        if (mRenderManager) {
+            DestroyRenderManagerImpl(mRenderManager);
+            mRenderManager = nullptr;
+        }
+        if (mBackBufferFramebuffer) {
+            if (IsInRenderingThread()) {
+                glDeleteFramebuffers(1, &mBackBufferFramebuffer);
+            } else {
+                ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRDeleteBackBufferFramebuffer,
+                    GLuint, framebuffer, mBackBufferFramebuffer,
+                    {
+                        glDeleteFramebuffers(1, &framebuffer);
+                    });
+            }
+        }
+    }
+
+    virtual bool UpdateViewport(const FViewport& InViewport, class FRHIViewport* InViewportRHI) override {
+        check(IsInGameThread());
+        if (!IsInitialized()) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("UpdateViewport called but custom present is not initialized - doing nothing"));
+            return false;
+        }
+        check(InViewportRHI);
+        if (InViewportRHI->GetCustomPresent() != this) {
+            InViewportRHI->SetCustomPresent(this);
+        }
+        // the back buffer RenderManager draws into, see ToolkitMakeCurrent
+        ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(OSVRSetPresentViewport,
+            TRefCountPtr<FCurrentCustomPresent>, present, this,
+            FViewportRHIRef, viewportRHI, InViewportRHI,
+            {
+                present->mViewportRHI = viewportRHI;
+            });
+        return true;
+    }
+
+    virtual bool AllocateRenderTargetTexture(uint32 index, uint32 sizeX, uint32 sizeY, uint8 format, uint32 numMips, uint32 flags, uint32 targetableTextureFlags, FTexture2DRHIRef& outTargetableTexture, FTexture2DRHIRef& outShaderResourceTexture, uint32 numSamples = 1) override {
+        check(IsInRenderingThread());
+        // registers the render buffers with RenderManager
+        if (!IsInitialized()) {
+            return false;
+        }
+        if (!CanReuseRenderTexture(sizeX, sizeY, format, numMips, numSamples)) {
+            // The OpenGL RHI makes a plain GL texture, which RenderManager
+            // samples from directly, so no wrapping is needed.
+            FRHIResourceCreateInfo createInfo(FClearValueBinding::Black);
+            mRenderTexture = RHICreateTexture2D(sizeX, sizeY, format, numMips, numSamples,
+                flags | targetableTextureFlags | TexCreate_ShaderResource, createInfo);
+            if (!IsValidRef(mRenderTexture)) {
+                UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Couldn't allocate a %ux%u render target for RenderManager."), sizeX, sizeY);
+                return false;
+            }
+            mRenderBuffersNeedToUpdate = true;
+        }
+        outTargetableTexture = mRenderTexture;
+        outShaderResourceTexture = mRenderTexture;
+        return UpdateRenderBuffers();
+    }
+
 protected:
-    virtual osvr::renderkit::GraphicsLibrary CreateGraphicsLibrary() override {
-        osvr::renderkit::GraphicsLibrary ret;
-        // OpenGL path not implemented yet
+    typedef TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> FOSVRClientContextRef;
+
+    OSVR_OpenGLToolkitFunctions mToolkit;
+    std::vector<OSVR_RenderBufferOpenGL> mRenderBuffers;
+    std::vector<OSVR_RenderInfoOpenGL> mRenderInfos;
+    OSVR_RenderManagerOpenGL mRenderManagerOpenGL = nullptr;
+    /** The viewport presented to. Render thread only. */
+    FViewportRHIRef mViewportRHI;
+    /** Has the viewport's back buffer attached, in the render thread's context. Render thread only. */
+    GLuint mBackBufferFramebuffer = 0;
+
+    virtual bool QueryRenderInfoImpl(uint32& OutSizeX, uint32& OutSizeY) override {
+        if (!IsInitialized()) {
+            return false;
+        }
+        OSVR_ReturnCode rc;
+        rc = osvrRenderManagerGetDefaultRenderParams(&mRenderParams);
+        check(rc == OSVR_RETURN_SUCCESS);
+        mRenderParams.roomFromHeadReplace = &mRenderHeadPose;
+
+        OSVR_RenderInfoCount numRenderInfo;
+        rc = osvrRenderManagerGetNumRenderInfo(mRenderManager, mRenderParams, &numRenderInfo);
+        check(rc == OSVR_RETURN_SUCCESS);
+
+        mRenderInfos.clear();
+        for (size_t i = 0; i < numRenderInfo; i++) {
+            OSVR_RenderInfoOpenGL renderInfo;
+            rc = osvrRenderManagerGetRenderInfoOpenGL(mRenderManagerOpenGL, i, mRenderParams, &renderInfo);
+            check(rc == OSVR_RETURN_SUCCESS);
+            mRenderInfos.push_back(renderInfo);
+        }
+
+        // same assumptions as the D3D11 present: two eyes side by side, same height
+        check(mRenderInfos.size() == 2);
+        check(mRenderInfos[0].viewport.height == mRenderInfos[1].viewport.height);
+        OutSizeX = mRenderInfos[0].viewport.width + mRenderInfos[1].viewport.width;
+        OutSizeY = mRenderInfos[0].viewport.height;
+        check(OutSizeX != 0 && OutSizeY != 0);
+        return true;
+    }
+
+    virtual bool CreateRenderManagerImpl() override {
+        check(IsInRenderingThread());
+        // the current one, which changes when the server is reconnected to
+        OSVR_ClientContext clientContext = mSharedClientContext->Get();
+        if (!clientContext) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("Can't initialize FOSVRCustomPresent without a valid client context"));
+            return false;
+        }
+
+        OSVR_ReturnCode rc = osvrCreateRenderManagerOpenGL(clientContext, GetGraphicsLibraryName().c_str(), CreateGraphicsLibrary(), &mRenderManager, &mRenderManagerOpenGL);
+        if (rc == OSVR_RETURN_FAILURE || !mRenderManager || !mRenderManagerOpenGL) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrCreateRenderManagerOpenGL call failed, or returned null renderManager/renderManagerOpenGL instances"));
+            return false;
+        }
+
+        rc = osvrRenderManagerGetDoingOkay(mRenderManager);
+        if (rc == OSVR_RETURN_FAILURE) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerGetDoingOkay call failed. Perhaps there was an error during initialization?"));
+            return false;
+        }
+        return true;
+    }
+
+    virtual bool OpenDisplayImpl() override {
+        check(IsInRenderingThread());
+        // compiles RenderManager's distortion shaders and buffers in the engine's context
+        FOSVRScopedGLState glState;
+        OSVR_OpenResultsOpenGL results;
+        OSVR_ReturnCode rc = osvrRenderManagerOpenDisplayOpenGL(mRenderManagerOpenGL, &results);
+        if (rc == OSVR_RETURN_FAILURE || results.status == OSVR_OPEN_STATUS_FAILURE) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerOpenDisplayOpenGL call failed, or the result status was OSVR_OPEN_STATUS_FAILURE."));
+            return false;
+        }
+        return true;
+    }
+
+    virtual void DestroyRenderManagerImpl(OSVR_RenderManager renderManager) override {
+        if (IsInRenderingThread()) {
+            FOSVRScopedGLState glState;
+            FOSVRCustomPresent::DestroyRenderManagerImpl(renderManager);
+            return;
+        }
+        // Its GL objects live in the engine's context, which is only current on
+        // the render thread. The extra registration keeps the client context up
+        // until then, even if the present is going away.
+        mSharedClientContext->Register(TEXT("OSVRDestroyRenderManager"));
+        ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(OSVRDestroyRenderManager,
+            OSVR_RenderManager, renderManager, renderManager,
+            FOSVRClientContextRef, clientContext, mSharedClientContext,
+            {
+                {
+                    FOSVRContextScopeLock contextLock(&clientContext->GetMutex());
+                    FOSVRScopedGLState glState;
+                    osvrDestroyRenderManager(renderManager);
+                }
+                clientContext->Unregister(TEXT("OSVRDestroyRenderManager"));
+            });
+    }
+
+    virtual void ResetRenderManagerImpl() override {
+        mRenderManagerOpenGL = nullptr;
+        mRenderBuffers.clear();
+        mRenderInfos.clear();
+    }
+
+    virtual bool FinishRendering() override {
+        check(IsInitialized());
+        if (!IsValidRef(mRenderTexture)) {
+            // the display opened after the viewport was set up; nothing to present until it's reallocated
+            return true;
+        }
+        if (!UpdateRenderBuffers()) {
+            return false;
+        }
+        OSVR_ReturnCode rc;
+
+        // The eye poses in the render infos are what timewarp corrects against,
+        // so get them again for the head pose the frame was actually rendered
+        // with (mRenderParams points to it). Only the poses change between
+        // frames; the viewports stay as cached.
+        for (size_t i = 0; i < mRenderInfos.size(); i++) {
+            rc = osvrRenderManagerGetRenderInfoOpenGL(mRenderManagerOpenGL, i, mRenderParams, &mRenderInfos[i]);
+            check(rc == OSVR_RETURN_SUCCESS);
+        }
+
+        FOSVRScopedGLState glState;
+        OSVR_RenderManagerPresentState presentState;
+        rc = osvrRenderManagerStartPresentRenderBuffers(&presentState);
+        check(rc == OSVR_RETURN_SUCCESS);
+        check(mRenderBuffers.size() == mRenderInfos.size() && mRenderBuffers.size() == mViewportDescriptions.size());
+        bool bPresented = true;
+        for (size_t i = 0; i < mRenderBuffers.size(); i++) {
+            rc = osvrRenderManagerPresentRenderBufferOpenGL(presentState, mRenderBuffers[i], mRenderInfos[i], mViewportDescriptions[i]);
+            bPresented = bPresented && rc == OSVR_RETURN_SUCCESS;
+        }
+        rc = osvrRenderManagerFinishPresentRenderBuffers(mRenderManager, presentState, mRenderParams, ShouldFlipY() ? OSVR_TRUE : OSVR_FALSE);
+        return bPresented && rc == OSVR_RETURN_SUCCESS;
+    }
+
+    virtual bool UpdateRenderBuffers() override {
+        check(IsInitialized());
+        if (!mRenderBuffersNeedToUpdate || !IsValidRef(mRenderTexture)) {
+            return true;
+        }
+        // Both eyes present from the one GL texture, each from its half.
+        const GLuint textureName = *reinterpret_cast<const GLuint*>(mRenderTexture->GetNativeResource());
+        mRenderBuffers.clear();
+        for (int i = 0; i < 2; i++) {
+            OSVR_RenderBufferOpenGL buffer;
+            buffer.colorBufferName = textureName;
+            buffer.depthStencilBufferName = 0;
+            mRenderBuffers.push_back(buffer);
+        }
+
+        OSVR_RenderManagerRegisterBufferState state;
+        OSVR_ReturnCode rc = osvrRenderManagerStartRegisterRenderBuffers(&state);
+        check(rc == OSVR_RETURN_SUCCESS);
+        for (size_t i = 0; i < mRenderBuffers.size(); i++) {
+            rc = osvrRenderManagerRegisterRenderBufferOpenGL(state, mRenderBuffers[i]);
+            check(rc == OSVR_RETURN_SUCCESS);
+        }
+        rc = osvrRenderManagerFinishRegisterRenderBuffers(mRenderManager, state, false);
+        if (rc != OSVR_RETURN_SUCCESS) {
+            UE_LOG(FOSVRCustomPresentLog, Warning, TEXT("osvrRenderManagerFinishRegisterRenderBuffers call failed."));
+            return false;
+        }
+
+        mViewportDescriptions.clear();
+        OSVR_ViewportDescription leftEye = { 0.0, 0.0, 0.5, 1.0 };
+        OSVR_ViewportDescription rightEye = { 0.5, 0.0, 0.5, 1.0 };
+        mViewportDescriptions.push_back(leftEye);
+        mViewportDescriptions.push_back(rightEye);
+
+        mRenderBuffersNeedToUpdate = false;
+        if (GetState() == PRESENT_OPENED) {
+            SetState(PRESENT_BUFFERS_REGISTERED);
+        }
+        return true;
+    }
+
+    virtual OSVR_GraphicsLibraryOpenGL CreateGraphicsLibrary() {
+        OSVR_GraphicsLibraryOpenGL ret;
+        ret.toolkit = &mToolkit;
         return ret;
     }
 
-    virtual const std::string& GetGraphicsLibraryName() override {
+    virtual std::string GetGraphicsLibraryName() override {
         return "OpenGL";
     }
 
     virtual bool ShouldFlipY() override {
-        return false;
+        // the OpenGL RHI renders into render targets upside down
+        return true;
     }
 
+    /**
+    * Binds a framebuffer with the viewport's back buffer attached, for the
+    * distortion pass to draw into. The engine then blits the back buffer to
+    * the window as usual when Present returns.
+    *
+    * @return False if the framebuffer isn't usable.
+    */
+    bool BindBackBuffer_RenderThread() {
+        check(IsInRenderingThread());
+        if (!IsValidRef(mViewportRHI)) {
+            // no viewport yet, e.g. for the warm-up frame: nothing is shown, so
+            // the render thread context's own default framebuffer will do
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return true;
+        }
+        // resizing the viewport replaces the back buffer, so attach it every time
+        FTexture2DRHIRef backBuffer = RHIGetViewportBackBuffer(mViewportRHI);
+        const GLuint textureName = *reinterpret_cast<const GLuint*>(backBuffer->GetNativeResource());
+        if (!mBackBufferFramebuffer) {
+            glGenFramebuffers(1, &mBackBufferFramebuffer);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, mBackBufferFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureName, 0);
+        return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    // RenderManager's window toolkit, standing in for its own SDL windows and
+    // contexts: it gets the engine's context, already current on the render
+    // thread, and leaves swapping to the engine.
+
+    static void ToolkitCreate(void* data) {}
+    static void ToolkitDestroy(void* data) {}
+
+    static OSVR_CBool ToolkitAddOpenGLContext(void* data, const OSVR_OpenGLContextParams* params) {
+        return IsInRenderingThread() ? OSVR_TRUE : OSVR_FALSE;
+    }
+
+    static OSVR_CBool ToolkitRemoveOpenGLContexts(void* data) {
+        return OSVR_TRUE;
+    }
+
+    static OSVR_CBool ToolkitMakeCurrent(void* data, size_t display) {
+        // the distortion pass draws into the viewport's back buffer
+        FCurrentCustomPresent* present = static_cast<FCurrentCustomPresent*>(data);
+        return present->BindBackBuffer_RenderThread() ? OSVR_TRUE : OSVR_FALSE;
+    }
+
+    static OSVR_CBool ToolkitSwapBuffers(void* data, size_t display) {
+        return OSVR_TRUE;
+    }
+
+    static OSVR_CBool ToolkitSetVerticalSync(void* data, OSVR_CBool verticalSync) {
+        // the engine's r.VSync applies
+        return OSVR_TRUE;
+    }
+
+    static OSVR_CBool ToolkitHandleEvents(void* data) {
+        return OSVR_TRUE;
+    }
 };
 
-#endif
+#endif // #if !PLATFORM_WINDOWS
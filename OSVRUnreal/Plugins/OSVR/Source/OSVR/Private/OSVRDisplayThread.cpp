@@ -0,0 +1,95 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRDisplayThread.h"
+
+#if PLATFORM_WINDOWS
+
+#include "AllowWindowsPlatformTypes.h"
+
+namespace {
+    // How often the window's messages are pumped while there's nothing to do
+    const uint32 MessagePumpIntervalMs = 10;
+}
+
+FOSVRDisplayThread::FOSVRDisplayThread()
+{
+    WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+}
+
+FOSVRDisplayThread::~FOSVRDisplayThread()
+{
+    if (Thread) {
+        Thread->Kill(true);
+        delete Thread;
+        Thread = nullptr;
+    }
+    FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+    WakeEvent = nullptr;
+}
+
+bool FOSVRDisplayThread::Start()
+{
+    check(!Thread);
+    Thread = FRunnableThread::Create(this, TEXT("OSVRDisplayThread"), 0, TPri_Normal);
+    if (!Thread) {
+        UE_LOG(OSVRLog, Warning, TEXT("Could not create the OSVR display thread."));
+        return false;
+    }
+    return true;
+}
+
+void FOSVRDisplayThread::Queue(const TFunction<void()>& Job)
+{
+    Jobs.Enqueue(Job);
+    WakeEvent->Trigger();
+}
+
+bool FOSVRDisplayThread::IsCurrentThread() const
+{
+    return Thread && Thread->GetThreadID() == FPlatformTLS::GetCurrentThreadId();
+}
+
+uint32 FOSVRDisplayThread::Run()
+{
+    while (StopCounter.GetValue() == 0) {
+        TFunction<void()> job;
+        while (Jobs.Dequeue(job)) {
+            job();
+        }
+
+        // only this thread's windows, i.e. RenderManager's
+        MSG message;
+        while (PeekMessage(&message, nullptr, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&message);
+            DispatchMessage(&message);
+        }
+
+        WakeEvent->Wait(MessagePumpIntervalMs);
+    }
+    return 0;
+}
+
+void FOSVRDisplayThread::Stop()
+{
+    StopCounter.Increment();
+    WakeEvent->Trigger();
+}
+
+#include "HideWindowsPlatformTypes.h"
+
+#endif // #if PLATFORM_WINDOWS
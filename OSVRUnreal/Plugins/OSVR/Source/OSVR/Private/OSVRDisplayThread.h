@@ -0,0 +1,58 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#if PLATFORM_WINDOWS
+
+#include "Containers/Queue.h"
+
+/**
+* Long-lived thread the D3D11 present opens, and destroys, RenderManager on.
+* In extended mode the window RenderManager opens belongs to the thread that
+* opened it, so that thread has to stay around and keep pumping the window's
+* messages for as long as the display is open; this one does between jobs.
+* Opening (and retrying after a hot-plug) therefore never stalls the render
+* thread, which keeps presenting the mirror meanwhile.
+*/
+class FOSVRDisplayThread : public FRunnable
+{
+public:
+    FOSVRDisplayThread();
+    virtual ~FOSVRDisplayThread();
+
+    /** Starts the thread. @return false if it could not be created. */
+    bool Start();
+
+    /** Runs Job on the thread, after the jobs queued before it. Any thread. */
+    void Queue(const TFunction<void()>& Job);
+
+    /** @return True when called from this thread. */
+    bool IsCurrentThread() const;
+
+    /** FRunnable interface */
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+
+private:
+    FRunnableThread* Thread = nullptr;
+    FThreadSafeCounter StopCounter;
+    /** Triggered when a job is queued, or the thread is stopped */
+    FEvent* WakeEvent = nullptr;
+    TQueue<TFunction<void()>, EQueueMode::Mpsc> Jobs;
+};
+
+#endif // #if PLATFORM_WINDOWS
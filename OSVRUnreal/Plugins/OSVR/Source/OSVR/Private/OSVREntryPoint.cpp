@@ -21,10 +21,29 @@
 #endif
 
 #include "OSVREntryPoint.h"
+#include "OSVRTrackingThread.h"
+#include "OSVRClockSync.h"
+#include "OSVRClientContext.h"
 
-OSVREntryPoint::OSVREntryPoint()
+OSVREntryPoint::OSVREntryPoint(TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> InClientContext)
+	: ClientContext(InClientContext)
 {
-	osvrClientContext = osvrClientInit("com.osvr.unreal.plugin");
+	osvrClientContext = ClientContext->Register(TEXT("OSVREntryPoint"), this);
+
+	FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+	for (int32 i = 0; i < TRACKED_PATH_COUNT; i++)
+	{
+		FTrackedPath& trackedPath = TrackedPaths[i];
+		trackedPath.Owner = this;
+		if (osvrClientContext && osvrClientGetInterface(osvrClientContext, OSVRTrackedPathName(EOSVRTrackedPath(i)), &trackedPath.Interface) == OSVR_RETURN_SUCCESS)
+		{
+			osvrRegisterPoseCallback(trackedPath.Interface, &OSVREntryPoint::PoseHistoryCallback, &trackedPath);
+		}
+		else
+		{
+			trackedPath.Interface = nullptr;
+		}
+	}
 
 #if OSVR_DEPRECATED_BLUEPRINT_API_ENABLED
 	InterfaceCollection = MakeShareable(new OSVRInterfaceCollection(
@@ -39,12 +58,102 @@ OSVREntryPoint::~OSVREntryPoint()
 	InterfaceCollection = nullptr;
 #endif
 
-	osvrClientShutdown(osvrClientContext);
+	{
+		FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+		for (int32 i = 0; i < TRACKED_PATH_COUNT; i++)
+		{
+			if (TrackedPaths[i].Interface)
+			{
+				osvrClientFreeInterface(osvrClientContext, TrackedPaths[i].Interface);
+			}
+		}
+	}
+
+	ClientContext->Unregister(TEXT("OSVREntryPoint"), this);
 }
 
 void OSVREntryPoint::Tick(float DeltaTime)
 {
-	osvrClientUpdate(osvrClientContext);
+	IOSVR::Get().GetClockSync()->Update();
+	// no-op if the HMD already pumped the context this frame
+	ClientContext->Update();
+}
+
+void OSVREntryPoint::PoseHistoryCallback(void* userdata, const OSVR_TimeValue* timestamp, const OSVR_PoseReport* report)
+{
+	FTrackedPath* trackedPath = static_cast<FTrackedPath*>(userdata);
+	const FQuat orientation = OSVR2FQuat(report->pose.rotation);
+	const FVector position = OSVR2FVector(report->pose.translation);
+
+	FScopeLock lock(&trackedPath->Owner->PoseHistoryMutex);
+	trackedPath->History.Add(*timestamp, orientation, position);
+}
+
+bool OSVREntryPoint::PrepareReconnect(OSVR_ClientContext NewContext)
+{
+	// The history carries on across the reconnect; the new reports just follow the old ones.
+	for (int32 i = 0; i < TRACKED_PATH_COUNT; i++)
+	{
+		FTrackedPath& trackedPath = TrackedPaths[i];
+		if (osvrClientGetInterface(NewContext, OSVRTrackedPathName(EOSVRTrackedPath(i)), &trackedPath.PendingInterface) == OSVR_RETURN_SUCCESS)
+		{
+			osvrRegisterPoseCallback(trackedPath.PendingInterface, &OSVREntryPoint::PoseHistoryCallback, &trackedPath);
+		}
+		else
+		{
+			trackedPath.PendingInterface = nullptr;
+		}
+	}
+	return true;
+}
+
+void OSVREntryPoint::CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext)
+{
+	for (int32 i = 0; i < TRACKED_PATH_COUNT; i++)
+	{
+		FTrackedPath& trackedPath = TrackedPaths[i];
+		if (trackedPath.Interface)
+		{
+			osvrClientFreeInterface(OldContext, trackedPath.Interface);
+		}
+		trackedPath.Interface = trackedPath.PendingInterface;
+		trackedPath.PendingInterface = nullptr;
+	}
+	osvrClientContext = NewContext;
+}
+
+void OSVREntryPoint::AbortReconnect(OSVR_ClientContext NewContext)
+{
+	for (int32 i = 0; i < TRACKED_PATH_COUNT; i++)
+	{
+		FTrackedPath& trackedPath = TrackedPaths[i];
+		if (trackedPath.PendingInterface)
+		{
+			osvrClientFreeInterface(NewContext, trackedPath.PendingInterface);
+			trackedPath.PendingInterface = nullptr;
+		}
+	}
+}
+
+bool OSVREntryPoint::GetPoseAtTime(EOSVRTrackedPath Path, const OSVR_TimeValue& Time, FQuat& OutOrientation, FVector& OutPosition)
+{
+	check(Path >= 0 && Path < TRACKED_PATH_COUNT);
+	FScopeLock lock(&PoseHistoryMutex);
+	return TrackedPaths[Path].History.GetPoseAtTime(Time, OutOrientation, OutPosition);
+}
+
+void OSVREntryPoint::FilterPose(EOSVRTrackedPath Path, const OSVR_TimeValue& Timestamp, OSVR_Pose3& InOutPose)
+{
+	if (!FOSVRPoseFilterBank::IsEnabled(Path))
+	{
+		return;
+	}
+
+	FScopeLock lock(&PoseFilterMutex);
+	PoseFilter.SetParams(Path, FOSVRPoseFilterParams::FromConsoleVariables());
+	PoseFilter.AddSample(Path, Timestamp, InOutPose);
+	PoseFilter.Filter();
+	PoseFilter.GetFilteredPose(Path, InOutPose);
 }
 
 #if OSVR_DEPRECATED_BLUEPRINT_API_ENABLED
@@ -20,11 +20,16 @@
 #include "OSVRInterfaceCollection.h"
 #endif
 
-OSVR_API class OSVREntryPoint : public FTickableGameObject
+#include "OSVRTypes.h"
+#include "OSVRPoseHistory.h"
+#include "OSVRPoseFilter.h"
+#include "OSVRClientContext.h"
+
+OSVR_API class OSVREntryPoint : public FTickableGameObject, public IOSVRClientContextListener
 {
 public:
 
-	OSVREntryPoint();
+	OSVREntryPoint(TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> InClientContext);
 	virtual ~OSVREntryPoint();
 
 	virtual void Tick(float DeltaTime) override;
@@ -46,16 +51,54 @@ public:
 		RETURN_QUICK_DECLARE_CYCLE_STAT(OSVREntryPoint, STATGROUP_Tickables);
 	}
 
-    virtual OSVR_ClientContext GetClientContext()
-    {
-        return osvrClientContext;
-    }
+    /**
+    * Gets the pose of a tracked path at an arbitrary OSVR time, interpolated
+    * from the reports received for that path. The pose is raw: Unreal axes,
+    * in meters, not relative to the HMD base. May be called from any thread.
+    *
+    * @return False if there is no report at or before Time.
+    */
+    virtual bool GetPoseAtTime(EOSVRTrackedPath Path, const OSVR_TimeValue& Time, FQuat& OutOrientation, FVector& OutPosition);
+
+    /**
+    * Runs a raw pose sampled outside the tracking thread through the jitter
+    * filter of its path (a no-op if that path isn't filtered, see
+    * FOSVRPoseFilterBank::IsEnabled). The tracking
+    * thread filters its own samples. May be called from any thread.
+    */
+    virtual void FilterPose(EOSVRTrackedPath Path, const OSVR_TimeValue& Timestamp, OSVR_Pose3& InOutPose);
+
+    /** IOSVRClientContextListener: moves the pose history interfaces over to a new context */
+    virtual bool PrepareReconnect(OSVR_ClientContext NewContext) override;
+    virtual void CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext) override;
+    virtual void AbortReconnect(OSVR_ClientContext NewContext) override;
 
 #if OSVR_DEPRECATED_BLUEPRINT_API_ENABLED
 	OSVRInterfaceCollection* GetInterfaceCollection();
 #endif
 
 private:
+    // about half a second of reports at 1kHz
+    static const int32 PoseHistoryCapacity = 512;
+
+    struct FTrackedPath
+    {
+        OSVREntryPoint* Owner = nullptr;
+        OSVR_ClientInterface Interface = nullptr;
+        /** From the context being reconnected to, see PrepareReconnect */
+        OSVR_ClientInterface PendingInterface = nullptr;
+        TOSVRPoseHistory<PoseHistoryCapacity> History;
+    };
+
+    static void PoseHistoryCallback(void* userdata, const OSVR_TimeValue* timestamp, const OSVR_PoseReport* report);
+
+    FTrackedPath TrackedPaths[TRACKED_PATH_COUNT];
+    FCriticalSection PoseHistoryMutex;
+
+    FOSVRPoseFilterBank PoseFilter;
+    FCriticalSection PoseFilterMutex;
+
+    TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> ClientContext;
     OSVR_ClientContext osvrClientContext = nullptr;
 
 #if OSVR_DEPRECATED_BLUEPRINT_API_ENABLED
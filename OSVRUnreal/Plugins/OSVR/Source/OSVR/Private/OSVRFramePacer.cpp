@@ -0,0 +1,65 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRFramePacer.h"
+
+namespace {
+    TAutoConsoleVariable<int32> CVarOSVRMaxFramesInFlight(
+        TEXT("osvr.MaxFramesInFlight"),
+        2,
+        TEXT("Most frames (1 to 3) the GPU may be behind the render thread before the render thread waits for it.\n")
+        TEXT("0 leaves queuing to the driver."),
+        ECVF_Default);
+}
+
+FOSVRFramePacer::FOSVRFramePacer() :
+    NumFramesEnded(0),
+    NumFramesFinished(0)
+{
+}
+
+void FOSVRFramePacer::WaitForFramesInFlight_RenderThread()
+{
+    check(IsInRenderingThread());
+    const int32 maxFramesInFlight = CVarOSVRMaxFramesInFlight.GetValueOnRenderThread();
+    if (maxFramesInFlight <= 0) {
+        return;
+    }
+    const uint64 framesInFlight = FMath::Clamp(maxFramesInFlight, 1, NumQueries - 1);
+    if (NumFramesEnded < framesInFlight || NumFramesEnded - framesInFlight < NumFramesFinished) {
+        return;
+    }
+
+    // The frames before this one are done too, since the GPU runs them in order.
+    const uint64 frame = NumFramesEnded - framesInFlight;
+    uint64 result = 0;
+    // waits, with a timeout of the RHI's in case the device is lost
+    RHIGetRenderQueryResult(Queries[frame % NumQueries], result, true);
+    NumFramesFinished = frame + 1;
+}
+
+void FOSVRFramePacer::EndFrame_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+    check(IsInRenderingThread());
+    FRenderQueryRHIRef& query = Queries[NumFramesEnded % NumQueries];
+    if (!IsValidRef(query)) {
+        query = RHICreateRenderQuery(RQT_AbsoluteTime);
+    }
+    RHICmdList.EndRenderQuery(query);
+    NumFramesEnded++;
+}
@@ -0,0 +1,58 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include "RHI.h"
+
+/**
+* Bounds how far the GPU can fall behind the render thread, in frames,
+* without draining it every frame the way r.FinishCurrentFrame does.
+*
+* A GPU query is issued at the end of each rendered frame. Before a frame
+* starts rendering, the render thread waits for the query of the frame
+* osvr.MaxFramesInFlight frames back, so at most that many frames are queued
+* on the GPU. The game thread, kept within a frame of the render thread by
+* the engine, can still prepare the next frame while the GPU finishes the
+* current one, and the latency from pose sample to scan-out stays bounded.
+*
+* Render thread only.
+*/
+class FOSVRFramePacer
+{
+public:
+    FOSVRFramePacer();
+
+    /**
+    * Waits for the GPU to have finished all but the last osvr.MaxFramesInFlight
+    * frames. Call before rendering a frame. Waiting again in the same frame does nothing.
+    */
+    void WaitForFramesInFlight_RenderThread();
+
+    /** Marks the end of a frame in the GPU's command stream. */
+    void EndFrame_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+private:
+    /** More than the maximum of osvr.MaxFramesInFlight, so no query is reused before it's waited for */
+    static const int32 NumQueries = 4;
+
+    FRenderQueryRHIRef Queries[NumQueries];
+    /** Frames ended so far; frame N's query is Queries[N % NumQueries]. */
+    uint64 NumFramesEnded;
+    /** Frames known to be finished on the GPU */
+    uint64 NumFramesFinished;
+};
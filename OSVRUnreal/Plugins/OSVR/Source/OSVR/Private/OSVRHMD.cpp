@@ -21,6 +21,8 @@
 #include "SharedPointer.h"
 #include "SceneViewport.h"
 #include "OSVREntryPoint.h"
+#include "OSVRTrackingThread.h"
+#include "OSVRClientContext.h"
 
 #if WITH_EDITOR
 #include "Editor/UnrealEd/Classes/Editor/EditorEngine.h"
@@ -41,6 +43,27 @@
 
 DEFINE_LOG_CATEGORY(OSVRHMDLog);
 
+namespace {
+    TAutoConsoleVariable<float> CVarOSVRPredictionHorizon(
+        TEXT("osvr.PredictionHorizonMs"),
+        16.0f,
+        TEXT("How far ahead of the current time, in milliseconds, the head pose is predicted. 0 disables prediction.\n")
+        TEXT("Can also be set with 'HMD PREDICTION <ms>'."),
+        ECVF_Default);
+
+    // Warn if a connection step takes longer than this. It is still retried.
+    const double ConnectionTimeoutSeconds = 10.0;
+
+    // Backoff between failed connection attempts
+    const double MinConnectionRetrySeconds = 0.1;
+    const double MaxConnectionRetrySeconds = 5.0;
+
+    float GetPredictionHorizonSeconds()
+    {
+        return FMath::Max(CVarOSVRPredictionHorizon.GetValueOnGameThread(), 0.0f) / 1000.0f;
+    }
+}
+
 //---------------------------------------------------
 // IHeadMountedDisplay Implementation
 //---------------------------------------------------
@@ -49,6 +72,14 @@ void FOSVRHMD::OnBeginPlay()
 {
     UE_LOG(OSVRHMDLog, Warning, TEXT("FOSVRHMD::OnBeginPlay()"));
     bPlaying = true;
+
+    // The RenderManager, its registered render target and the interfaces all
+    // outlive play sessions. The play viewport may have been set up before
+    // play began, while the custom present was kept off it, so attach it now.
+    FSceneViewport* sceneViewport = FindSceneViewport();
+    if (sceneViewport && sceneViewport->GetViewportRHI().IsValid()) {
+        UpdateViewport(ShouldUseSeparateRenderTarget(), *sceneViewport, nullptr);
+    }
 }
 
 void FOSVRHMD::OnEndPlay()
@@ -59,12 +90,12 @@ void FOSVRHMD::OnEndPlay()
 
 bool FOSVRHMD::IsHMDConnected()
 {
-    return bHmdConnected;
+    return IsConnected();
 }
 
 bool FOSVRHMD::IsHMDEnabled() const
 {
-    return bHmdConnected && bHmdEnabled;
+    return IsConnected() && bHmdEnabled;
 }
 
 void FOSVRHMD::EnableHMD(bool enable)
@@ -99,8 +130,14 @@ void FOSVRHMD::GetMonitorInfo(IHeadMountedDisplay::MonitorInfo& MonitorDesc) con
 
 bool FOSVRHMD::GetHMDMonitorInfo(MonitorInfo& MonitorDesc)
 {
-    if (IsInitialized()
-        && osvrClientCheckDisplayStartup(DisplayConfig) == OSVR_RETURN_SUCCESS)
+    bool bDisplayUp = false;
+    if (IsConnected()) {
+        FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+        bDisplayUp = osvrClientCheckDisplayStartup(DisplayConfig) == OSVR_RETURN_SUCCESS;
+    }
+
+    // a saved display profile is good enough to size the window before the server answers
+    if (bDisplayUp || HMDDescription.IsFromProfile())
     {
         GetMonitorInfo(MonitorDesc);
         return true;
@@ -116,17 +153,137 @@ bool FOSVRHMD::GetHMDMonitorInfo(MonitorInfo& MonitorDesc)
 }
 
 void FOSVRHMD::UpdateHeadPose() {
+    check(IsInGameThread());
+    if (HeadPose.FrameNumber == GFrameCounter) {
+        return;
+    }
+    // Stamp the frame even if sampling fails below, so the remaining
+    // consumers this frame reuse the last good pose instead of retrying.
+    HeadPose.FrameNumber = GFrameCounter;
+
     OSVR_Pose3 pose;
-    OSVR_ReturnCode returnCode;
+    if (ClientContext->Update() == OSVR_RETURN_FAILURE) {
+        // UpdateConnection notices and drops the connection
+        return;
+    }
+    if (!ClientContext->IsConnected()) {
+        // No reports while the server is reconnected to: hold the last pose
+        // instead of extrapolating it further and further.
+        HeadPosePredictor.Reset();
+    }
+
+    PredictionHorizon = GetPredictionHorizonSeconds();
+    if (SampleViewerPose(pose, HeadPose.Timestamp)) {
+        PredictRawPose(&HeadPosePredictor, HeadPosePredictor, PredictionHorizon, pose, HeadPose.Timestamp,
+            HeadPose.RawPose, HeadPose.PredictedTime);
+        ToBaseRelativePose(HeadPose.RawPose, BaseOrientation, BasePosition, WorldToMetersScale, HeadPose.Orientation, HeadPose.Position);
+        HeadPose.bValid = true;
+    }
+
+    PoseState.CurHmdPosition = HeadPose.Position;
+    PoseState.CurHmdOrientation = HeadPose.Orientation;
+    PublishPoseState();
+}
+
+void FOSVRHMD::PublishPoseState()
+{
+    check(IsInGameThread());
+    PoseState.Version++;
+    PublishedPoseState.Write(PoseState);
+}
+
+FOSVRHMDPoseState FOSVRHMD::GetPoseState() const
+{
+    return IsInGameThread() ? PoseState : PublishedPoseState.Read();
+}
+
+bool FOSVRHMD::SampleViewerPose(OSVR_Pose3& OutPose, OSVR_TimeValue& OutTimestamp) {
+    FOSVRTrackingThread* trackingThread = IOSVR::Get().GetTrackingThread();
+    if (trackingThread) {
+        FOSVRTrackingState state;
+        if (!trackingThread->GetLatestState(state) || !state.bViewerPoseValid) {
+            return false;
+        }
+        OutPose = state.ViewerPose;
+        OutTimestamp = state.bPoseValid[TRACKED_PATH_HEAD] ? state.PoseTimestamps[TRACKED_PATH_HEAD] : state.SampleTime;
+        return true;
+    }
+
+    // the tracking thread, a reconnect, or the input device may be using the context too
+    FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+    if (osvrClientGetViewerPose(DisplayConfig, 0, &OutPose) != OSVR_RETURN_SUCCESS) {
+        return false;
+    }
+    OSVR_PoseState headState;
+    if (!HeadInterface || osvrGetPoseState(HeadInterface, &OutTimestamp, &headState) != OSVR_RETURN_SUCCESS) {
+        osvrTimeValueGetNow(&OutTimestamp);
+    }
+    IOSVR::Get().GetEntryPoint()->FilterPose(TRACKED_PATH_HEAD, OutTimestamp, OutPose);
+    return true;
+}
+
+bool FOSVRHMD::SampleViewerPose_RenderThread(OSVR_Pose3& OutPose, OSVR_TimeValue& OutTimestamp) const {
+    check(IsInRenderingThread());
+    FOSVRTrackingThread* trackingThread = IOSVR::Get().GetTrackingThread();
+    if (trackingThread) {
+        FOSVRTrackingState state;
+        if (!trackingThread->GetLatestState(state) || !state.bViewerPoseValid) {
+            return false;
+        }
+        OutPose = state.ViewerPose;
+        OutTimestamp = state.bPoseValid[TRACKED_PATH_HEAD] ? state.PoseTimestamps[TRACKED_PATH_HEAD] : state.SampleTime;
+        return true;
+    }
+
+    // ClientKit isn't thread-safe, and the game thread owns the context when
+    // the tracking thread is off; keep the game thread's pose then.
+    return false;
+}
+
+void FOSVRHMD::PredictRawPose(FOSVRPosePredictor* Predictor, const FOSVRPosePredictor& Estimate, float PredictionHorizon,
+    const OSVR_Pose3& RawPose, const OSVR_TimeValue& Timestamp, OSVR_Pose3& OutPose, OSVR_TimeValue& OutPredictedTime)
+{
+    const FQuat orientation = OSVR2FQuat(RawPose.rotation);
+    const FVector position = OSVR2FVector(RawPose.translation);
+    if (Predictor) {
+        Predictor->AddSample(Timestamp, orientation, position);
+    }
+
+    OutPose = RawPose;
+    OutPredictedTime = Timestamp;
+    if (PredictionHorizon <= 0.0f || !Estimate.HasVelocity()) {
+        return;
+    }
+
+    // Extrapolate from the report time, so the age of the report is made up for too.
+    OSVR_TimeValue now;
+    osvrTimeValueGetNow(&now);
+    OutPredictedTime = OSVRTimeValueAddSeconds(now, PredictionHorizon);
+
+    FQuat predictedOrientation;
+    FVector predictedPosition;
+    Estimate.Extrapolate(Timestamp, orientation, position, OutPredictedTime, predictedOrientation, predictedPosition);
+    OutPose.rotation = FQuat2OSVR(predictedOrientation);
+    OutPose.translation = FVector2OSVR(predictedPosition);
+}
 
-    returnCode = osvrClientUpdate(IOSVR::Get().GetEntryPoint()->GetClientContext());
-    check(returnCode == OSVR_RETURN_SUCCESS);
+void FOSVRHMD::ToBaseRelativePose(const OSVR_Pose3& RawPose, const FQuat& InBaseOrientation, const FVector& InBasePosition,
+    float InWorldToMetersScale, FQuat& OutOrientation, FVector& OutPosition)
+{
+    OutPosition = InBaseOrientation.Inverse().RotateVector((OSVR2FVector(RawPose.translation) * InWorldToMetersScale) - InBasePosition);
+    OutOrientation = InBaseOrientation.Inverse() * OSVR2FQuat(RawPose.rotation);
+}
 
-    returnCode = osvrClientGetViewerPose(DisplayConfig, 0, &pose);
-    if (returnCode == OSVR_RETURN_SUCCESS) {
-        CurHmdPosition = BaseOrientation.Inverse().RotateVector((OSVR2FVector(pose.translation) * WorldToMetersScale) - BasePosition);
-        CurHmdOrientation = BaseOrientation.Inverse() * OSVR2FQuat(pose.rotation);
+bool FOSVRHMD::GetHeadPoseAtTime(const OSVR_TimeValue& Time, FQuat& OutOrientation, FVector& OutPosition) const
+{
+    FQuat rawOrientation;
+    FVector rawPosition;
+    if (!IOSVR::Get().GetEntryPoint()->GetPoseAtTime(TRACKED_PATH_HEAD, Time, rawOrientation, rawPosition)) {
+        return false;
     }
+    OutPosition = BaseOrientation.Inverse().RotateVector((rawPosition * WorldToMetersScale) - BasePosition);
+    OutOrientation = BaseOrientation.Inverse() * rawOrientation;
+    return true;
 }
 
 bool FOSVRHMD::DoesSupportPositionalTracking() const
@@ -158,9 +315,11 @@ void FOSVRHMD::EnableLowPersistenceMode(bool Enable)
 
 bool FOSVRHMD::OnStartGameFrame(FWorldContext& WorldContext) {
     check(IsInGameThread());
-    if (!bHmdOverridesApplied) {
-        IConsoleManager::Get().FindConsoleVariable(TEXT("r.FinishCurrentFrame"))->Set(1);
-        bHmdOverridesApplied = true;
+
+    // This is the one place per frame where the head pose is sampled.
+    UpdateConnection();
+    if (IsConnected()) {
+        UpdateHeadPose();
     }
     return true;
 }
@@ -188,8 +347,9 @@ void FOSVRHMD::GetCurrentOrientationAndPosition(FQuat& CurrentOrientation, FVect
     checkf(IsInGameThread(), TEXT("Orientation and position failed IsInGameThread test"));
     UpdateHeadPose();
 
-    CurrentOrientation = LastHmdOrientation = CurHmdOrientation;
-    CurrentPosition = CurHmdPosition;
+    CurrentOrientation = PoseState.LastHmdOrientation = PoseState.CurHmdOrientation;
+    CurrentPosition = PoseState.CurHmdPosition;
+    PublishPoseState();
 }
 
 void FOSVRHMD::RebaseObjectOrientationAndPosition(FVector& Position, FQuat& Orientation) const
@@ -203,19 +363,20 @@ void FOSVRHMD::ApplyHmdRotation(APlayerController* PC, FRotator& ViewRotation)
 
     UpdateHeadPose();
 
-    LastHmdOrientation = CurHmdOrientation;
+    PoseState.LastHmdOrientation = PoseState.CurHmdOrientation;
 
     const FRotator DeltaRot = ViewRotation - PC->GetControlRotation();
-    DeltaControlRotation = (DeltaControlRotation + DeltaRot).GetNormalized();
+    PoseState.DeltaControlRotation = (PoseState.DeltaControlRotation + DeltaRot).GetNormalized();
 
     // Pitch from other sources is never good, because there is an absolute up and down that must be respected to avoid motion sickness.
     // Same with roll. Retain yaw by default - mouse/controller based yaw movement still isn't pleasant, but
     // it's necessary for sitting VR experiences.
-    DeltaControlRotation.Pitch = 0;
-    DeltaControlRotation.Roll = 0;
-    DeltaControlOrientation = DeltaControlRotation.Quaternion();
+    PoseState.DeltaControlRotation.Pitch = 0;
+    PoseState.DeltaControlRotation.Roll = 0;
+    PoseState.DeltaControlOrientation = PoseState.DeltaControlRotation.Quaternion();
+    PublishPoseState();
 
-    ViewRotation = FRotator(DeltaControlOrientation * CurHmdOrientation);
+    ViewRotation = FRotator(PoseState.DeltaControlOrientation * PoseState.CurHmdOrientation);
 }
 
 #if OSVR_UNREAL_3_11
@@ -223,11 +384,12 @@ bool FOSVRHMD::UpdatePlayerCamera(FQuat& CurrentOrientation, FVector& CurrentPos
 {
     UpdateHeadPose();
 
-    LastHmdOrientation = CurHmdOrientation;
-    //LastHmdPosition = CurHmdPosition; // @todo: why aren't we doing this?
+    PoseState.LastHmdOrientation = PoseState.CurHmdOrientation;
+    //PoseState.LastHmdPosition = PoseState.CurHmdPosition; // @todo: why aren't we doing this?
+    PublishPoseState();
 
-    CurrentOrientation = CurHmdOrientation;
-    CurrentPosition = CurHmdPosition;
+    CurrentOrientation = PoseState.CurHmdOrientation;
+    CurrentPosition = PoseState.CurHmdPosition;
 
     return true;
 }
@@ -236,14 +398,15 @@ void FOSVRHMD::UpdatePlayerCameraRotation(APlayerCameraManager* Camera, struct F
 {
     UpdateHeadPose();
 
-    LastHmdOrientation = CurHmdOrientation;
-    //LastHmdPosition = CurHmdPosition; // @todo: why aren't we doing this?
+    PoseState.LastHmdOrientation = PoseState.CurHmdOrientation;
+    //PoseState.LastHmdPosition = PoseState.CurHmdPosition; // @todo: why aren't we doing this?
 
-    DeltaControlRotation = POV.Rotation;
-    DeltaControlOrientation = DeltaControlRotation.Quaternion();
+    PoseState.DeltaControlRotation = POV.Rotation;
+    PoseState.DeltaControlOrientation = PoseState.DeltaControlRotation.Quaternion();
+    PublishPoseState();
 
     // Apply HMD orientation to camera rotation.
-    POV.Rotation = FRotator(POV.Rotation.Quaternion() * CurHmdOrientation);
+    POV.Rotation = FRotator(POV.Rotation.Quaternion() * PoseState.CurHmdOrientation);
 }
 #endif
 
@@ -291,6 +454,24 @@ bool FOSVRHMD::Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar)
             EnableHMD(false);
             return true;
         }
+        else if (FParse::Command(&Cmd, TEXT("PREDICTION")))
+        {
+            // HMD PREDICTION [OFF|<milliseconds>]
+            if (FParse::Command(&Cmd, TEXT("OFF")))
+            {
+                CVarOSVRPredictionHorizon->Set(0.0f);
+            }
+            else
+            {
+                FString value = FParse::Token(Cmd, false);
+                if (value.IsNumeric())
+                {
+                    CVarOSVRPredictionHorizon->Set(FCString::Atof(*value));
+                }
+            }
+            Ar.Logf(TEXT("HMD pose prediction horizon: %.1f ms"), CVarOSVRPredictionHorizon.GetValueOnGameThread());
+            return true;
+        }
     }
     else if (FParse::Command(&Cmd, TEXT("UNCAPFPS")))
     {
@@ -323,7 +504,11 @@ bool FOSVRHMD::Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar)
 
 void FOSVRHMD::OnScreenModeChange(EWindowMode::Type WindowMode)
 {
-    EnableStereo(WindowMode != EWindowMode::Windowed);
+    // EnableStereo's own resolution request lands here too
+    const bool stereo = WindowMode != EWindowMode::Windowed;
+    if (stereo != bStereoEnabled) {
+        EnableStereo(stereo);
+    }
 }
 
 bool FOSVRHMD::IsPositionalTrackingEnabled() const
@@ -343,7 +528,7 @@ bool FOSVRHMD::EnablePositionalTracking(bool enable)
 
 bool FOSVRHMD::IsStereoEnabled() const
 {
-    return bStereoEnabled && bHmdEnabled;
+    return bStereoEnabled && bHmdEnabled && IsConnected();
 }
 
 bool FOSVRHMD::EnableStereo(bool stereo)
@@ -352,11 +537,40 @@ bool FOSVRHMD::EnableStereo(bool stereo)
 
     auto leftEye = HMDDescription.GetDisplaySize(OSVRHMDDescription::LEFT_EYE);
     auto rightEye = HMDDescription.GetDisplaySize(OSVRHMDDescription::RIGHT_EYE);
-    auto width = leftEye.X + rightEye.X;
-    auto height = leftEye.Y;
-    FSystemResolution::RequestResolutionChange(width, height, stereo ? EWindowMode::WindowedMirror : EWindowMode::Windowed);
+    const int32 width = FMath::TruncToInt(leftEye.X + rightEye.X);
+    const int32 height = FMath::TruncToInt(leftEye.Y);
+    const EWindowMode::Type windowMode = stereo ? EWindowMode::WindowedMirror : EWindowMode::Windowed;
+
+    // Toggling in and out of stereo with the same display is common (pause
+    // menus, spectator hand-off); only resize when something changed. The
+    // stereo render target stays with the custom present meanwhile, still
+    // registered with RenderManager, and is handed back to the viewport by
+    // AllocateRenderTargetTexture.
+    bool resized = false;
+    if (GSystemResolution.ResX != width || GSystemResolution.ResY != height || GSystemResolution.WindowMode != windowMode) {
+        FSystemResolution::RequestResolutionChange(width, height, windowMode);
+        resized = true;
+    }
+
+    FSceneViewport* sceneViewport = FindSceneViewport();
+    if (sceneViewport && sceneViewport->GetSizeXY() != FIntPoint(width, height)) {
+        sceneViewport->SetViewportSize(width, height);
+        resized = true;
+    }
+
+    // RenderManager may size its render target for the new window
+    if (resized && mCustomPresent) {
+        mCustomPresent->InvalidateRenderInfo();
+    }
+
+    GEngine->bForceDisableFrameRateSmoothing = stereo;
 
-    FSceneViewport* sceneViewport;
+    return bStereoEnabled;
+}
+
+FSceneViewport* FOSVRHMD::FindSceneViewport() const
+{
+    FSceneViewport* sceneViewport = nullptr;
     if (!GIsEditor) {
         UGameEngine* gameEngine = Cast<UGameEngine>(GEngine);
         sceneViewport = gameEngine->SceneViewport.Get();
@@ -367,20 +581,14 @@ bool FOSVRHMD::EnableStereo(bool stereo)
         sceneViewport = (FSceneViewport*)(editorEngine->GetPIEViewport());
     }
 #endif
-
-    if (sceneViewport) {
-        sceneViewport->SetViewportSize(width, height);
-    }
-
-    GEngine->bForceDisableFrameRateSmoothing = stereo;
-
-    return bStereoEnabled;
+    return sceneViewport;
 }
 
 void FOSVRHMD::AdjustViewRect(EStereoscopicPass StereoPass, int32& X, int32& Y, uint32& SizeX, uint32& SizeY) const
 {
-    if (mCustomPresent && mCustomPresent->IsInitialized()) {
-        mCustomPresent->CalculateRenderTargetSize(SizeX, SizeY);
+    if (mCustomPresent) {
+        // cached when the display opened; no RenderManager calls per eye
+        mCustomPresent->GetRenderTargetSize(SizeX, SizeY);
     }
     SizeX = SizeX / 2;
     if (StereoPass == eSSP_RIGHT_EYE)
@@ -397,9 +605,13 @@ void FOSVRHMD::CalculateStereoViewOffset(const EStereoscopicPass StereoPassType,
         const float PassOffset = (StereoPassType == eSSP_LEFT_EYE) ? -EyeOffset : EyeOffset;
         ViewLocation += ViewRotation.Quaternion().RotateVector(FVector(0, PassOffset, 0));
 
-        const FVector vHMDPosition = DeltaControlOrientation.RotateVector(CurHmdPosition);
+        const FOSVRHMDPoseState poseState = GetPoseState();
+        const FVector vHMDPosition = poseState.DeltaControlOrientation.RotateVector(poseState.CurHmdPosition);
         ViewLocation += vHMDPosition;
-        LastHmdPosition = CurHmdPosition;
+        if (IsInGameThread()) {
+            PoseState.LastHmdPosition = poseState.CurHmdPosition;
+            PublishPoseState();
+        }
     }
 }
 
@@ -418,12 +630,11 @@ void FOSVRHMD::ResetOrientation(bool adjustOrientation, float yaw)
 {
     FQuat CurrentRotation(FQuat::Identity);
 
-    OSVR_PoseState Pose;
-    OSVR_ReturnCode ReturnCode = osvrClientGetViewerPose(DisplayConfig, 0, &Pose);
-    if (ReturnCode != OSVR_RETURN_SUCCESS)
+    UpdateHeadPose();
+    if (!HeadPose.bValid)
         return;
 
-    CurrentRotation = OSVR2FQuat(Pose.rotation);
+    CurrentRotation = OSVR2FQuat(HeadPose.RawPose.rotation);
 
     if (adjustOrientation)
     {
@@ -450,12 +661,12 @@ void FOSVRHMD::ResetOrientation(bool adjustOrientation, float yaw)
 void FOSVRHMD::ResetPosition()
 {
     FVector CurrentPosition(FVector::ZeroVector);
-    OSVR_PoseState Pose;
-    OSVR_ReturnCode ReturnCode = osvrClientGetViewerPose(DisplayConfig, 0, &Pose);
-    if (ReturnCode != OSVR_RETURN_SUCCESS)
+
+    UpdateHeadPose();
+    if (!HeadPose.bValid)
         return;
 
-    CurrentPosition = OSVR2FVector(Pose.translation);
+    CurrentPosition = OSVR2FVector(HeadPose.RawPose.translation);
 
     // Reset position
     BasePosition = CurrentPosition * WorldToMetersScale;
@@ -474,8 +685,7 @@ namespace {
 FMatrix FOSVRHMD::GetStereoProjectionMatrix(enum EStereoscopicPass StereoPassType, const float FOV) const
 {
     FMatrix original = HMDDescription.GetProjectionMatrix(
-        StereoPassType == eSSP_LEFT_EYE ? OSVRHMDDescription::LEFT_EYE : OSVRHMDDescription::RIGHT_EYE,
-        DisplayConfig);
+        StereoPassType == eSSP_LEFT_EYE ? OSVRHMDDescription::LEFT_EYE : OSVRHMDDescription::RIGHT_EYE);
 
     // @todo we should be getting a matrix from core, but this doesn't appear to be working.
     //OSVR_EyeCount eye = 0;
@@ -536,8 +746,9 @@ void FOSVRHMD::SetupViewFamily(FSceneViewFamily& InViewFamily)
 
 void FOSVRHMD::SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView)
 {
-    InView.BaseHmdOrientation = FQuat(FRotator(0.0f, 0.0f, 0.0f));
-    InView.BaseHmdLocation = FVector(0.f);
+    // The render thread late-latches against the pose the view was set up with.
+    InView.BaseHmdOrientation = HeadPose.Orientation;
+    InView.BaseHmdLocation = HeadPose.Position;
     WorldToMetersScale = InView.WorldToMetersScale;
     InViewFamily.bUseSeparateRenderTarget = true;
 }
@@ -548,24 +759,19 @@ bool FOSVRHMD::IsHeadTrackingAllowed() const
 }
 
 FOSVRHMD::FOSVRHMD()
-    : LastHmdOrientation(FQuat::Identity),
-    CurHmdOrientation(FQuat::Identity),
-    DeltaControlRotation(FRotator::ZeroRotator),
-    DeltaControlOrientation(FQuat::Identity),
-    CurHmdPosition(FVector::ZeroVector),
-    BaseOrientation(FQuat::Identity),
+    : BaseOrientation(FQuat::Identity),
     BasePosition(FVector::ZeroVector),
     WorldToMetersScale(100.0f),
     bHmdPosTracking(false),
     bHaveVisionTracking(false),
     bStereoEnabled(true),
     bHmdEnabled(true),
-    bHmdOverridesApplied(false),
+    ClientContext(IOSVR::Get().GetClientContext()),
     DisplayConfig(nullptr)
 {
     static const FName RendererModuleName("Renderer");
     RendererModule = FModuleManager::GetModulePtr<IRendererModule>(RendererModuleName);
-    OSVR_ClientContext osvrClientContext = IOSVR::Get().GetEntryPoint()->GetClientContext();
+    OSVR_ClientContext osvrClientContext = ClientContext->Register(TEXT("FOSVRHMD"), this);
 
     // Prevents debugger hangs that sometimes occur with only one monitor.
 #if OSVR_UNREAL_DEBUG_FORCED_WINDOWMODE
@@ -575,8 +781,13 @@ FOSVRHMD::FOSVRHMD()
     EnablePositionalTracking(true);
 
 #if PLATFORM_WINDOWS
-    if (IsPCPlatform(GMaxRHIShaderPlatform) && !IsOpenGLPlatform(GMaxRHIShaderPlatform)) {
-        mCustomPresent = new FCurrentCustomPresent(osvrClientContext);
+    if (IsPCPlatform(GMaxRHIShaderPlatform) && !IsOpenGLPlatform(GMaxRHIShaderPlatform)
+        && IOSVR::Get().LoadRenderManagerModule()) {
+        mCustomPresent = new FCurrentCustomPresent(ClientContext);
+    }
+#else
+    if (IsOpenGLPlatform(GMaxRHIShaderPlatform) && IOSVR::Get().LoadRenderManagerModule()) {
+        mCustomPresent = new FCurrentCustomPresent(ClientContext);
     }
 #endif
 
@@ -592,82 +803,248 @@ FOSVRHMD::FOSVRHMD()
     // Uncap fps to enable FPS higher than 62
     GEngine->bSmoothFrameRate = false;
 
-    // check if the client context is ok.
-    bool clientContextOK = false;
-    {  
-        size_t numTries = 0;
-        bool failure = false;
-        while (numTries++ < 10000 && !clientContextOK && !failure) {
-            clientContextOK = osvrClientCheckStatus(osvrClientContext) == OSVR_RETURN_SUCCESS;
-            if (!clientContextOK) {
-                failure = osvrClientUpdate(osvrClientContext) == OSVR_RETURN_FAILURE;
-                if (failure) {
-                    UE_LOG(OSVRHMDLog, Warning, TEXT("osvrClientUpdate failed during startup. Treating this as \"HMD not connected\""));
-                    break;
-                }
+    bInitialized = osvrClientContext != nullptr;
+    HMDDescription.LoadLastProfile();
+    ConnectionStateStartTime = FPlatformTime::Seconds();
+
+    // Connecting is driven from OnStartGameFrame; this only takes the first step,
+    // so a running server with a ready display connects before the first frame.
+    UpdateConnection();
+}
+
+FOSVRHMD::~FOSVRHMD()
+{
+    EnablePositionalTracking(false);
+    {
+        FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+        if (HeadInterface) {
+            osvrClientFreeInterface(ClientContext->Get(), HeadInterface);
+        }
+        if (DisplayConfig) {
+            osvrClientFreeDisplay(DisplayConfig);
+        }
+    }
+    ClientContext->Unregister(TEXT("FOSVRHMD"), this);
+}
+
+bool FOSVRHMD::IsInitialized() const
+{
+    return bInitialized;
+}
+
+void FOSVRHMD::UpdateConnection()
+{
+    check(IsInGameThread());
+    if (!bInitialized) {
+        return;
+    }
+
+    // may swap in a reconnected context, see CommitReconnect
+    ClientContext->Update();
+    OSVR_ClientContext osvrClientContext = ClientContext->Get();
+
+    if (!ClientContext->IsConnected()) {
+        // The server may just be restarting. The client context reconnects in
+        // the background, so keep going with the last pose for a while.
+        if (ConnectionState >= CONNECTION_DESCRIPTION_VALID) {
+            if (!bHoldingLastPose) {
+                UE_LOG(OSVRHMDLog, Warning, TEXT("Lost the connection to the OSVR server. Holding the last head pose while reconnecting."));
+                bHoldingLastPose = true;
+                HoldLastPoseStartTime = FPlatformTime::Seconds();
+            }
+            if (FPlatformTime::Seconds() - HoldLastPoseStartTime <= ConnectionTimeoutSeconds) {
+                return;
             }
         }
-        if (!clientContextOK) {
-            UE_LOG(OSVRHMDLog, Warning, TEXT("OSVR client context did not initialize correctly. Most likely the server isn't running. Treating this as if the HMD is not connected."));
+
+        // Gone for good, it seems. The display config and description are
+        // kept, so reconnecting only waits for the server.
+        if (ConnectionState != CONNECTION_DISCONNECTED) {
+            UE_LOG(OSVRHMDLog, Warning, TEXT("Lost the connection to the OSVR server. Treating this as \"HMD not connected\" until it's back."));
+            ConnectionState = CONNECTION_DISCONNECTED;
+            ConnectionStateStartTime = FPlatformTime::Seconds();
         }
-        clientContextOK = clientContextOK && !failure;
+        return;
     }
+    bHoldingLastPose = false;
 
-    // get the display context
-    bool displayConfigOK = false;
-    if (clientContextOK)
-    {
-        bool failure = false;
-        auto rc = osvrClientGetDisplay(osvrClientContext, &DisplayConfig);
-        if (rc == OSVR_RETURN_FAILURE) {
+    const double now = FPlatformTime::Seconds();
+    if (now < NextConnectionAttemptTime) {
+        return;
+    }
+
+    const EOSVRConnectionState previousState = ConnectionState;
+    switch (ConnectionState) {
+    case CONNECTION_DISCONNECTED:
+        ConnectionState = CONNECTION_CONTEXT_UP;
+        break;
+
+    case CONNECTION_CONTEXT_UP: {
+        FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+        if (!DisplayConfig && osvrClientGetDisplay(osvrClientContext, &DisplayConfig) == OSVR_RETURN_FAILURE) {
             UE_LOG(OSVRHMDLog, Warning, TEXT("Could not create DisplayConfig. Treating this as if the HMD is not connected."));
+            DisplayConfig = nullptr;
+            BackOffConnection();
+            break;
+        }
+        if (osvrClientCheckDisplayStartup(DisplayConfig) == OSVR_RETURN_SUCCESS) {
+            ConnectionState = CONNECTION_DISPLAY_UP;
+        } else if (now - ConnectionStateStartTime > ConnectionTimeoutSeconds && !bLoggedConnectionTimeout) {
+            UE_LOG(OSVRHMDLog, Warning, TEXT("DisplayConfig failed to startup. This could mean that there is nothing mapped to /me/head. Treating this as if the HMD is not connected."));
+            bLoggedConnectionTimeout = true;
+        }
+        break;
+    }
+
+    case CONNECTION_DISPLAY_UP:
+        if (!InitHMDDescription()) {
+            BackOffConnection();
         } else {
-            int numTries = 0;
-            while (!displayConfigOK && numTries++ < 10000) {
-                displayConfigOK = osvrClientCheckDisplayStartup(DisplayConfig) == OSVR_RETURN_SUCCESS;
-                if (!displayConfigOK) {
-                    failure = osvrClientUpdate(osvrClientContext) == OSVR_RETURN_FAILURE;
-                    if (failure) {
-                        UE_LOG(OSVRHMDLog, Warning, TEXT("osvrClientUpdate failed during startup. Treating this as \"HMD not connected\""));
-                        break;
-                    }
-                }
-            }
-            displayConfigOK = displayConfigOK && !failure;
-            if (!displayConfigOK) {
-                UE_LOG(OSVRHMDLog, Warning, TEXT("DisplayConfig failed to startup. This could mean that there is nothing mapped to /me/head. Treating this as if the HMD is not connected."));
+            ConnectionState = CONNECTION_DESCRIPTION_VALID;
+
+            // a new description may come with a new IPD, and with it new render infos
+            if (mCustomPresent) {
+                mCustomPresent->InvalidateRenderInfo();
             }
+
+            // The tracking thread can only take over pumping once the display config is up.
+            // Not under the mutex: starting it waits for its Init, which takes the mutex.
+            IOSVR::Get().StartTrackingThread();
         }
+        break;
+
+    case CONNECTION_DESCRIPTION_VALID:
+        // the custom present opens its display in the background, and retries on its own
+        if (mCustomPresent) {
+            mCustomPresent->UpdateLifecycle();
+        }
+        if (!mCustomPresent || mCustomPresent->IsInitialized()) {
+            ConnectionState = CONNECTION_PRESENT_READY;
+        }
+        if (mCustomPresent && ConnectionState == CONNECTION_PRESENT_READY) {
+            // the display is (re)opened; get the first frame's costs out of the way now
+            ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(OSVRWarmUp,
+                FOSVRHMD*, HMD, this,
+                {
+                    HMD->WarmUp_RenderThread(RHICmdList);
+                });
+        }
+        break;
+
+    case CONNECTION_PRESENT_READY:
+        if (mCustomPresent && !mCustomPresent->IsInitialized()) {
+            // lost the display (unplugged, or taken by another app in direct mode); mirror until it's back
+            ConnectionState = CONNECTION_DESCRIPTION_VALID;
+        }
+        break;
     }
 
-    bool displayConfigMatchesUnrealExpectations = false;
-    if (displayConfigOK) {
-        bool success = HMDDescription.Init(osvrClientContext, DisplayConfig);
-        if (success) {
-            displayConfigMatchesUnrealExpectations = HMDDescription.OSVRViewerFitsUnrealModel(DisplayConfig);
-            if (!displayConfigMatchesUnrealExpectations) {
-                UE_LOG(OSVRHMDLog, Warning, TEXT("The OSVR display config does not match the expectations of Unreal. Possibly incompatible HMD configuration."));
-            }
-        } else {
+    if (ConnectionState != previousState) {
+        ConnectionStateStartTime = now;
+        ConnectionRetryInterval = 0.0;
+        bLoggedConnectionTimeout = false;
+    }
+}
+
+bool FOSVRHMD::InitHMDDescription()
+{
+    OSVR_ClientContext osvrClientContext = ClientContext->Get();
+    {
+        FOSVRContextScopeLock lock(&ClientContext->GetMutex());
+        if (!HMDDescription.Init(osvrClientContext, DisplayConfig)) {
             UE_LOG(OSVRHMDLog, Warning, TEXT("Unable to initialize the HMDDescription. Possible failures during initialization."));
+            return false;
+        }
+        if (!HMDDescription.OSVRViewerFitsUnrealModel(DisplayConfig)) {
+            UE_LOG(OSVRHMDLog, Warning, TEXT("The OSVR display config does not match the expectations of Unreal. Possibly incompatible HMD configuration."));
+            return false;
+        }
+        if (!HeadInterface && osvrClientGetInterface(osvrClientContext, "/me/head", &HeadInterface) != OSVR_RETURN_SUCCESS) {
+            UE_LOG(OSVRHMDLog, Warning, TEXT("Could not get the /me/head interface. Head poses will be stamped with the local OSVR time instead."));
+            HeadInterface = nullptr;
         }
     }
+    // file I/O, so not under the mutex
+    HMDDescription.SaveProfile();
+    return true;
+}
 
-    // our version of connected is that the client context is ok (server is running)
-    // and the display config is ok (/me/head exists and received a pose)
-    bHmdConnected = clientContextOK && displayConfigOK && displayConfigMatchesUnrealExpectations;
+void FOSVRHMD::BackOffConnection()
+{
+    ConnectionRetryInterval = FMath::Clamp(ConnectionRetryInterval * 2.0, MinConnectionRetrySeconds, MaxConnectionRetrySeconds);
+    NextConnectionAttemptTime = FPlatformTime::Seconds() + ConnectionRetryInterval;
 }
 
-FOSVRHMD::~FOSVRHMD()
+bool FOSVRHMD::PrepareReconnect(OSVR_ClientContext NewContext)
 {
-    EnablePositionalTracking(false);
+    if (osvrClientGetDisplay(NewContext, &PendingDisplayConfig) == OSVR_RETURN_FAILURE) {
+        UE_LOG(OSVRHMDLog, Warning, TEXT("Could not create a DisplayConfig on the reconnected OSVR client context."));
+        PendingDisplayConfig = nullptr;
+        return false;
+    }
+    if (!ClientContext->PumpNewContextUntil(NewContext, [this]() {
+        return osvrClientCheckDisplayStartup(PendingDisplayConfig) == OSVR_RETURN_SUCCESS;
+    })) {
+        osvrClientFreeDisplay(PendingDisplayConfig);
+        PendingDisplayConfig = nullptr;
+        return false;
+    }
+    if (osvrClientGetInterface(NewContext, "/me/head", &PendingHeadInterface) != OSVR_RETURN_SUCCESS) {
+        PendingHeadInterface = nullptr;
+    }
+
+    // Only a different display needs the description, and with it the render target, redone.
+    bPendingDisplayMatches = HMDDescription.MatchesDisplayConfig(NewContext, PendingDisplayConfig);
+    return true;
+}
+
+void FOSVRHMD::BeginReconnect()
+{
+    // both hold on to the current context and display config
+    IOSVR::Get().StopTrackingThread();
+    if (mCustomPresent) {
+        mCustomPresent->Reopen();
+    }
+}
+
+void FOSVRHMD::CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext)
+{
+    if (HeadInterface) {
+        osvrClientFreeInterface(OldContext, HeadInterface);
+    }
     if (DisplayConfig) {
         osvrClientFreeDisplay(DisplayConfig);
     }
+    HeadInterface = PendingHeadInterface;
+    DisplayConfig = PendingDisplayConfig;
+    PendingHeadInterface = nullptr;
+    PendingDisplayConfig = nullptr;
+
+    if (ConnectionState >= CONNECTION_DISPLAY_UP && !bPendingDisplayMatches) {
+        UE_LOG(OSVRHMDLog, Log, TEXT("The reconnected OSVR server describes a different display. Updating the HMD description."));
+        ConnectionState = CONNECTION_DISPLAY_UP;
+        ConnectionStateStartTime = FPlatformTime::Seconds();
+        ConnectionRetryInterval = 0.0;
+        NextConnectionAttemptTime = 0.0;
+    }
+    bHoldingLastPose = false;
 }
 
-bool FOSVRHMD::IsInitialized() const
+void FOSVRHMD::EndReconnect()
 {
-    // @TODO
-    return true;
+    if (ConnectionState >= CONNECTION_DESCRIPTION_VALID) {
+        IOSVR::Get().StartTrackingThread();
+    }
+}
+
+void FOSVRHMD::AbortReconnect(OSVR_ClientContext NewContext)
+{
+    if (PendingHeadInterface) {
+        osvrClientFreeInterface(NewContext, PendingHeadInterface);
+        PendingHeadInterface = nullptr;
+    }
+    if (PendingDisplayConfig) {
+        osvrClientFreeDisplay(PendingDisplayConfig);
+        PendingDisplayConfig = nullptr;
+    }
 }
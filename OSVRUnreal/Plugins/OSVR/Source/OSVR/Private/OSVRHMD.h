@@ -17,14 +17,20 @@
 #pragma once
 
 #include "IOSVR.h"
+#include "OSVRClientContext.h"
+#include "OSVRFramePacer.h"
 #include "OSVRHMDDescription.h"
+#include "OSVRPosePredictor.h"
+#include "OSVRSeqLock.h"
 #include "HeadMountedDisplay.h"
 #include "IHeadMountedDisplay.h"
 #include "SceneViewExtension.h"
 #include "SceneView.h"
 #include "ShowFlags.h"
+#include "GlobalShader.h"
 
 #include <osvr/ClientKit/DisplayC.h>
+#include <osvr/Util/TimeValueC.h>
 
 #if PLATFORM_WINDOWS
 #include "OSVRCustomPresentD3D11.h"
@@ -32,12 +38,78 @@
 #include "OSVRCustomPresentOpenGL.h"
 #endif
 
+class FSceneViewport;
+
 DECLARE_LOG_CATEGORY_EXTERN(OSVRHMDLog, Log, All);
 
+/**
+* The viewer pose as sampled once per game frame. Every game-thread consumer of
+* the head pose reads this instead of querying OSVR itself.
+*/
+struct FOSVRHeadPoseSnapshot
+{
+    /** Orientation relative to BaseOrientation */
+    FQuat Orientation = FQuat::Identity;
+
+    /** Position relative to BasePosition, in world units */
+    FVector Position = FVector::ZeroVector;
+
+    /** Raw viewer pose in OSVR room space (meters), predicted to PredictedTime */
+    OSVR_Pose3 RawPose;
+
+    /** OSVR timestamp of the /me/head report the pose was sampled from */
+    OSVR_TimeValue Timestamp = { 0, 0 };
+
+    /** Time the pose was extrapolated to. Same as Timestamp when prediction is off. */
+    OSVR_TimeValue PredictedTime = { 0, 0 };
+
+    /** GFrameCounter value of the frame this snapshot belongs to */
+    uint64 FrameNumber = MAX_uint64;
+
+    /** False until the first successful osvrClientGetViewerPose call */
+    bool bValid = false;
+};
+
+/**
+* Tracking state the game thread applies to the player camera. The game thread
+* owns the working copy and publishes a snapshot after each change, so other
+* threads can read a consistent copy without taking a lock.
+*/
+struct FOSVRHMDPoseState
+{
+    /** Incremented on every publish */
+    uint64 Version = 0;
+
+    /** Player's orientation tracking */
+    FQuat CurHmdOrientation = FQuat::Identity;
+    FVector CurHmdPosition = FVector::ZeroVector;
+
+    FQuat LastHmdOrientation = FQuat::Identity; // contains last APPLIED ON GT HMD orientation
+    FVector LastHmdPosition = FVector::ZeroVector; // contains last APPLIED ON GT HMD position
+
+    FRotator DeltaControlRotation = FRotator::ZeroRotator; // same as DeltaControlOrientation but as rotator
+    FQuat DeltaControlOrientation = FQuat::Identity; // same as DeltaControlRotation but as quat
+};
+
+/** How far the HMD got connecting to the OSVR server, in order. */
+enum EOSVRConnectionState
+{
+    /** No server yet */
+    CONNECTION_DISCONNECTED = 0,
+    /** The client context is connected to the server */
+    CONNECTION_CONTEXT_UP,
+    /** The display config has started up (/me/head has reported) */
+    CONNECTION_DISPLAY_UP,
+    /** The HMD description was read and fits the Unreal model; the HMD is connected */
+    CONNECTION_DESCRIPTION_VALID,
+    /** The custom present, if any, has its display open too */
+    CONNECTION_PRESENT_READY
+};
+
 /**
 * OSVR Head Mounted Display
 */
-class FOSVRHMD : public IHeadMountedDisplay, public ISceneViewExtension, public TSharedFromThis< FOSVRHMD, ESPMode::ThreadSafe >
+class FOSVRHMD : public IHeadMountedDisplay, public ISceneViewExtension, public IOSVRClientContextListener, public TSharedFromThis< FOSVRHMD, ESPMode::ThreadSafe >
 {
 public:
 
@@ -131,9 +203,7 @@ public:
         return mCustomPresent;
     }
 
-    virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
-    {
-    }
+    virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
     virtual void PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView) override;
     virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override;
 
@@ -150,6 +220,10 @@ public:
         return WorldToMetersScale;
     }
 
+    inline OSVR_DisplayConfig GetDisplayConfig() const {
+        return DisplayConfig;
+    }
+
 public:
     /** Constructor */
     FOSVRHMD();
@@ -157,25 +231,168 @@ public:
     /** Destructor */
     virtual ~FOSVRHMD();
 
-    /** @return	True if the HMD was initialized OK */
+    /**
+    * @return	True if the HMD was initialized OK. It may still be connecting;
+    *			see IsHMDConnected and GetConnectionState.
+    */
     bool IsInitialized() const;
 
+    EOSVRConnectionState GetConnectionState() const
+    {
+        return ConnectionState;
+    }
+
+    /**
+    * Gets the head pose at an arbitrary OSVR time, interpolated from the
+    * /me/head report history, in the same base-relative space as GetCurrentOrientationAndPosition.
+    *
+    * @return False if Time is older than the retained history.
+    */
+    bool GetHeadPoseAtTime(const OSVR_TimeValue& Time, FQuat& OutOrientation, FVector& OutPosition) const;
+
+    /**
+    * @return The camera tracking state: the working copy on the game thread,
+    * the last published snapshot on any other thread.
+    */
+    FOSVRHMDPoseState GetPoseState() const;
+
 private:
     void GetMonitorInfo(IHeadMountedDisplay::MonitorInfo& MonitorDesc) const;
+
+    /** @return The game's viewport, or the Play-In-Editor one in the editor. May be null. */
+    FSceneViewport* FindSceneViewport() const;
+
+    /**
+    * Advances the connection state machine by at most one attempt. Never
+    * blocks: the client context is pumped by the entry point, and failed
+    * attempts are retried with exponential backoff.
+    */
+    void UpdateConnection();
+
+    /** Fails the current connection attempt and schedules the next one. */
+    void BackOffConnection();
+
+    /**
+    * Initializes the HMD description from the display config, and gets the
+    * head interface, under the client context mutex.
+    *
+    * @return False if the display config doesn't describe a usable HMD.
+    */
+    bool InitHMDDescription();
+
+    /**
+    * IOSVRClientContextListener: gets the display config and /me/head from the
+    * new context. The tracking thread and the present's RenderManager are
+    * restarted around the swap; the render target and the description are
+    * kept unless the new display differs.
+    */
+    virtual bool PrepareReconnect(OSVR_ClientContext NewContext) override;
+    virtual void BeginReconnect() override;
+    virtual void CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext) override;
+    virtual void EndReconnect() override;
+    virtual void AbortReconnect(OSVR_ClientContext NewContext) override;
+
+    bool IsConnected() const
+    {
+        return ConnectionState >= CONNECTION_DESCRIPTION_VALID;
+    }
+
+    /** Samples the head pose snapshot for the current frame if it hasn't been sampled yet. */
     void UpdateHeadPose();
 
+    /**
+    * Gets the latest raw viewer pose, from the tracking thread if it's running,
+    * or from the (already updated) client context otherwise.
+    */
+    bool SampleViewerPose(OSVR_Pose3& OutPose, OSVR_TimeValue& OutTimestamp);
+
+    /**
+    * Render thread counterpart of SampleViewerPose. Only reads what the
+    * tracking thread published, so it fails, and the game thread pose is
+    * rendered, while the tracking thread is off.
+    */
+    bool SampleViewerPose_RenderThread(OSVR_Pose3& OutPose, OSVR_TimeValue& OutTimestamp) const;
+
+    /**
+    * Feeds a freshly sampled raw pose to Predictor (when not null) and
+    * extrapolates it PredictionHorizon seconds past now.
+    */
+    static void PredictRawPose(FOSVRPosePredictor* Predictor, const FOSVRPosePredictor& Estimate, float PredictionHorizon,
+        const OSVR_Pose3& RawPose, const OSVR_TimeValue& Timestamp, OSVR_Pose3& OutPose, OSVR_TimeValue& OutPredictedTime);
+
+    /** Converts a raw OSVR viewer pose into the HMD's base-relative Unreal space. */
+    static void ToBaseRelativePose(const OSVR_Pose3& RawPose, const FQuat& InBaseOrientation, const FVector& InBasePosition,
+        float InWorldToMetersScale, FQuat& OutOrientation, FVector& OutPosition);
+
+    /** Game-thread state the render thread needs for late latching, copied once per view family. */
+    struct FRenderThreadFrame
+    {
+        FQuat BaseOrientation = FQuat::Identity;
+        FVector BasePosition = FVector::ZeroVector;
+        FQuat DeltaControlOrientation = FQuat::Identity;
+        float WorldToMetersScale = 100.0f;
+        float InterpupillaryDistance = 0.0f;
+        bool bLateLatch = false;
+
+        /** Game thread head pose the views were set up with */
+        FOSVRHeadPoseSnapshot HeadPose;
+
+        /** Game thread's velocity estimate, used to predict the late-latched pose the same way */
+        FOSVRPosePredictor HeadPosePredictor;
+        float PredictionHorizon = 0.0f;
+    };
+
+    /** Render thread only */
+    FRenderThreadFrame RenderThreadFrame;
+
+    /** Head pose re-sampled on the render thread for the view family being drawn. Render thread only. */
+    FOSVRHeadPoseSnapshot LatchedHeadPose;
+
+    /**
+    * Pose the current view family is actually rendered with: LatchedHeadPose
+    * if late latching succeeded, the game thread pose otherwise. Render thread only.
+    */
+    FOSVRHeadPoseSnapshot RenderedHeadPose;
+
+    /** Created by the first DrawMirror_RenderThread, see WarmUp_RenderThread. Render thread only. */
+    mutable FGlobalBoundShaderState MirrorBoundShaderState;
+
+    /** Keeps the GPU from queuing more than osvr.MaxFramesInFlight frames. Render thread only. */
+    mutable FOSVRFramePacer FramePacer;
+
+    /** Copies SrcTexture onto all of Target with the screen shaders. */
+    void DrawMirror_RenderThread(FRHICommandListImmediate& RHICmdList, FTexture2DRHIParamRef Target, FTextureRHIParamRef SrcTexture) const;
+
+    /**
+    * Pays the first-frame costs while the game is still loading, once the
+    * present's display is open: binds the mirror shaders, allocates and
+    * registers the render target RenderManager asked for (the viewport then
+    * gets that one from AllocateRenderTargetTexture), and presents a black
+    * frame so RenderManager sets up its own pipeline.
+    */
+    void WarmUp_RenderThread(FRHICommandListImmediate& RHICmdList);
+
     IRendererModule* RendererModule;
 
-    /** Player's orientation tracking */
-    mutable FQuat CurHmdOrientation;
+    /** Head pose for the current game frame, see UpdateHeadPose */
+    FOSVRHeadPoseSnapshot HeadPose;
 
-    FRotator DeltaControlRotation; // same as DeltaControlOrientation but as rotator
-    FQuat DeltaControlOrientation; // same as DeltaControlRotation but as quat
+    /** /me/head, only used to timestamp the viewer pose */
+    OSVR_ClientInterface HeadInterface = nullptr;
 
-    mutable FVector CurHmdPosition;
+    /** Velocity estimate for the viewer pose, game thread only */
+    FOSVRPosePredictor HeadPosePredictor;
 
-    mutable FQuat LastHmdOrientation; // contains last APPLIED ON GT HMD orientation
-    FVector LastHmdPosition;		  // contains last APPLIED ON GT HMD position
+    /** Prediction horizon in seconds for the current frame, from osvr.PredictionHorizonMs */
+    float PredictionHorizon = 0.0f;
+
+    /** Game thread only; call PublishPoseState after changing it */
+    FOSVRHMDPoseState PoseState;
+
+    /** Snapshot of PoseState for other threads */
+    TOSVRSeqLock<FOSVRHMDPoseState> PublishedPoseState;
+
+    void PublishPoseState();
 
                                       /** HMD base values, specify forward orientation and zero pos offset */
     FQuat BaseOrientation; // base orientation
@@ -189,12 +406,29 @@ private:
 
     bool bStereoEnabled;
     bool bHmdEnabled;
-    bool bHmdConnected;
-    bool bHmdOverridesApplied;
-    bool bWaitedForClientStatus = false;
+    bool bInitialized = false;
+
+    /** Game thread writes only */
+    EOSVRConnectionState ConnectionState = CONNECTION_DISCONNECTED;
+    double ConnectionStateStartTime = 0.0;
+    double NextConnectionAttemptTime = 0.0;
+    double ConnectionRetryInterval = 0.0;
+    bool bLoggedConnectionTimeout = false;
+    /** Set once the warning that late latching can't run is logged */
+    bool bLoggedLateLatchInert = false;
+    /** See UpdateConnection */
+    bool bHoldingLastPose = false;
+    double HoldLastPoseStartTime = 0.0;
     bool bPlaying = false;
 
     OSVRHMDDescription HMDDescription;
+    TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> ClientContext;
     OSVR_DisplayConfig DisplayConfig;
+
+    /** From the context being reconnected to, see PrepareReconnect */
+    OSVR_DisplayConfig PendingDisplayConfig = nullptr;
+    OSVR_ClientInterface PendingHeadInterface = nullptr;
+    bool bPendingDisplayMatches = false;
+
     TRefCountPtr<FCurrentCustomPresent> mCustomPresent;
 };
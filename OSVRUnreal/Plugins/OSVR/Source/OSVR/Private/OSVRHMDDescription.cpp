@@ -20,19 +20,69 @@
 #include "Json.h"
 
 #include <cmath>
+#include <vector>
 
 DEFINE_LOG_CATEGORY(OSVRHMDDescriptionLog);
 
+namespace {
+    // Display profile file format. Bump the version whenever DescriptionData's serialization changes.
+    const uint32 ProfileMagic = 0x5056534F; // "OSVP"
+    const int32 ProfileVersion = 1;
+}
+
 DescriptionData::DescriptionData()
+	: RenderTargetSize(0, 0)
 {
 	// Set defaults...
 	for (int i = 0; i < 2; ++i)
 	{
 		DisplaySize[i].Set(960, 1080);
 		Fov[i].Set(90, 101.25f);
+		EyePosition[i] = FVector::ZeroVector;
+		for (int j = 0; j < 4; ++j)
+		{
+			Viewport[i][j] = 0;
+			ClippingPlanes[i][j] = 0.0;
+		}
+		// symmetric planes matching the default FOV
+		ClippingPlanes[i][0] = -1.0;
+		ClippingPlanes[i][1] = 1.0;
+		ClippingPlanes[i][2] = -1.19;
+		ClippingPlanes[i][3] = 1.19;
 	}
 }
 
+bool DescriptionData::MatchesDisplay(const DescriptionData& Other) const
+{
+    for (int i = 0; i < 2; ++i) {
+        if (!DisplaySize[i].Equals(Other.DisplaySize[i]) || !EyePosition[i].Equals(Other.EyePosition[i], 1.0e-4f)) {
+            return false;
+        }
+        for (int j = 0; j < 4; ++j) {
+            if (Viewport[i][j] != Other.Viewport[i][j]
+                || !FMath::IsNearlyEqual(ClippingPlanes[i][j], Other.ClippingPlanes[i][j], 1.0e-4)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+FArchive& operator<<(FArchive& Ar, DescriptionData& Data)
+{
+    for (int i = 0; i < 2; ++i) {
+        Ar << Data.DisplaySize[i];
+        Ar << Data.Fov[i];
+        Ar << Data.EyePosition[i];
+        for (int j = 0; j < 4; ++j) {
+            Ar << Data.Viewport[i][j];
+            Ar << Data.ClippingPlanes[i][j];
+        }
+    }
+    Ar << Data.RenderTargetSize;
+    return Ar;
+}
+
 OSVRHMDDescription::OSVRHMDDescription()
 	: Valid(false),
 	  Data(new DescriptionData())
@@ -113,6 +163,9 @@ bool OSVRHMDDescription::InitIPD(OSVR_DisplayConfig displayConfig) {
         UE_LOG(OSVRHMDDescriptionLog, Warning, TEXT("osvrClientGetViewerEyePose call failed for right eye"));
     }
 
+    Data->EyePosition[0].Set(leftEye.translation.data[0], leftEye.translation.data[1], leftEye.translation.data[2]);
+    Data->EyePosition[1].Set(rightEye.translation.data[0], rightEye.translation.data[1], rightEye.translation.data[2]);
+
     double dx = leftEye.translation.data[0] - rightEye.translation.data[0];
     double dy = leftEye.translation.data[1] - rightEye.translation.data[1];
     double dz = leftEye.translation.data[2] - rightEye.translation.data[2];
@@ -144,6 +197,16 @@ bool OSVRHMDDescription::InitDisplaySize(OSVR_DisplayConfig displayConfig) {
 
     Data->DisplaySize[0].Set(leftViewportWidth, leftViewportHeight);
     Data->DisplaySize[1].Set(rightViewportWidth, rightViewportHeight);
+
+    const OSVR_ViewportDimension viewports[2][4] = {
+        { leftViewportLeft, leftViewportBottom, leftViewportWidth, leftViewportHeight },
+        { rightViewportLeft, rightViewportBottom, rightViewportWidth, rightViewportHeight }
+    };
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            Data->Viewport[i][j] = viewports[i][j];
+        }
+    }
     return true;
 }
 
@@ -151,12 +214,18 @@ bool OSVRHMDDescription::InitFOV(OSVR_DisplayConfig displayConfig) {
     OSVR_ReturnCode returnCode;
     for (OSVR_EyeCount eye = 0; eye < 2; eye++) {
         double left, right, top, bottom;
-        returnCode = osvrClientGetViewerEyeSurfaceProjectionClippingPlanes(displayConfig, 0, 0, eye, &left, &right, &bottom, &top);
+        returnCode = osvrClientGetViewerEyeSurfaceProjectionClippingPlanes(displayConfig, 0, eye, 0, &left, &right, &bottom, &top);
         if (returnCode == OSVR_RETURN_FAILURE) {
             UE_LOG(OSVRHMDDescriptionLog, Warning, TEXT("osvrClientGetViewerEyeSurfaceProjectionClippingPlanes call failed"));
             return false;
         }
 
+        // cached for GetProjectionMatrix
+        Data->ClippingPlanes[eye][0] = left;
+        Data->ClippingPlanes[eye][1] = right;
+        Data->ClippingPlanes[eye][2] = bottom;
+        Data->ClippingPlanes[eye][3] = top;
+
         double horizontalFOV = FMath::RadiansToDegrees(std::atan(std::abs(left)) + std::atan(std::abs(right)));
         double verticalFOV = FMath::RadiansToDegrees(std::atan(std::abs(top)) + std::atan(std::abs(bottom)));
         Data->Fov[eye].Set(horizontalFOV, verticalFOV);
@@ -167,6 +236,12 @@ bool OSVRHMDDescription::InitFOV(OSVR_DisplayConfig displayConfig) {
 bool OSVRHMDDescription::Init(OSVR_ClientContext OSVRClientContext, OSVR_DisplayConfig displayConfig)
 {
 	Valid = false;
+
+    // what the saved profile said, to validate against the live values
+    const DescriptionData profileData = *Data;
+    const bool wasFromProfile = FromProfile;
+    const FString profileKey = ProfileKey;
+    FromProfile = false;
     
     // if the OSVR viewer doesn't fit nicely with the Unreal HMD model, don't
     // bother trying to fill everything else out.
@@ -188,9 +263,146 @@ bool OSVRHMDDescription::Init(OSVR_ClientContext OSVRClientContext, OSVR_Display
         return false; 
     }
     Valid = true;
+
+    ProfileKey = GetDisplayKey(OSVRClientContext);
+    const bool sameDisplay = wasFromProfile && ProfileKey == profileKey;
+    if (sameDisplay && profileData.MatchesDisplay(*Data)) {
+        UE_LOG(OSVRHMDDescriptionLog, Log, TEXT("The saved display profile matches the live display config."));
+    } else if (wasFromProfile) {
+        UE_LOG(OSVRHMDDescriptionLog, Log, TEXT("The saved display profile is out of date. Replacing it."));
+    }
+    // the render target size comes from RenderManager later on
+    Data->RenderTargetSize = sameDisplay ? profileData.RenderTargetSize : FIntPoint(0, 0);
 	return Valid;
 }
 
+bool OSVRHMDDescription::MatchesDisplayConfig(OSVR_ClientContext OSVRClientContext, OSVR_DisplayConfig displayConfig) const
+{
+    if (!Valid) {
+        return false;
+    }
+    OSVRHMDDescription live;
+    if (!live.OSVRViewerFitsUnrealModel(displayConfig) || !live.InitIPD(displayConfig)
+        || !live.InitDisplaySize(displayConfig) || !live.InitFOV(displayConfig)) {
+        return false;
+    }
+    return GetDisplayKey(OSVRClientContext) == ProfileKey
+        && live.Data->MatchesDisplay(*Data)
+        && FMath::IsNearlyEqual(live.m_ipd, m_ipd, 1.0e-4f);
+}
+
+FString OSVRHMDDescription::GetDisplayKey(OSVR_ClientContext OSVRClientContext)
+{
+    size_t length = 0;
+    if (osvrClientGetStringParameterLength(OSVRClientContext, "/display", &length) == OSVR_RETURN_FAILURE || length == 0) {
+        UE_LOG(OSVRHMDDescriptionLog, Warning, TEXT("Could not read the display descriptor. The display profile won't be saved."));
+        return FString();
+    }
+    std::vector<char> descriptor(length);
+    if (osvrClientGetStringParameter(OSVRClientContext, "/display", descriptor.data(), length) == OSVR_RETURN_FAILURE) {
+        UE_LOG(OSVRHMDDescriptionLog, Warning, TEXT("Could not read the display descriptor. The display profile won't be saved."));
+        return FString();
+    }
+    return FMD5::HashAnsiString(ANSI_TO_TCHAR(descriptor.data()));
+}
+
+FString OSVRHMDDescription::GetProfilePath(const FString& Key)
+{
+    return FPaths::GameSavedDir() / TEXT("OSVR") / (Key + TEXT(".osvrprofile"));
+}
+
+FString OSVRHMDDescription::GetLastProfilePath()
+{
+    return FPaths::GameSavedDir() / TEXT("OSVR") / TEXT("LastProfile.txt");
+}
+
+bool OSVRHMDDescription::LoadLastProfile()
+{
+    FString key;
+    if (!FFileHelper::LoadFileToString(key, *GetLastProfilePath())) {
+        return false;
+    }
+    key.Trim();
+    key.TrimTrailing();
+
+    DescriptionData data;
+    float ipd;
+    if (key.IsEmpty() || !LoadProfile(key, data, ipd)) {
+        return false;
+    }
+
+    *Data = data;
+    m_ipd = ipd;
+    ProfileKey = key;
+    FromProfile = true;
+    UE_LOG(OSVRHMDDescriptionLog, Log, TEXT("Loaded the display profile %s."), *key);
+    return true;
+}
+
+bool OSVRHMDDescription::LoadProfile(const FString& Key, DescriptionData& OutData, float& OutIpd) const
+{
+    TArray<uint8> bytes;
+    if (!FFileHelper::LoadFileToArray(bytes, *GetProfilePath(Key))) {
+        return false;
+    }
+
+    FMemoryReader reader(bytes);
+    uint32 magic = 0;
+    int32 version = 0;
+    FString key;
+    reader << magic;
+    reader << version;
+    if (magic != ProfileMagic || version != ProfileVersion) {
+        UE_LOG(OSVRHMDDescriptionLog, Log, TEXT("Ignoring the display profile %s from another plugin version."), *Key);
+        return false;
+    }
+    reader << key;
+    reader << OutIpd;
+    reader << OutData;
+    return !reader.IsError() && key == Key;
+}
+
+bool OSVRHMDDescription::SaveProfile() const
+{
+    if (ProfileKey.IsEmpty()) {
+        return false;
+    }
+
+    TArray<uint8> bytes;
+    FMemoryWriter writer(bytes);
+    uint32 magic = ProfileMagic;
+    int32 version = ProfileVersion;
+    FString key = ProfileKey;
+    float ipd = m_ipd;
+    writer << magic;
+    writer << version;
+    writer << key;
+    writer << ipd;
+    writer << *Data;
+
+    if (!FFileHelper::SaveArrayToFile(bytes, *GetProfilePath(ProfileKey))
+        || !FFileHelper::SaveStringToFile(ProfileKey, *GetLastProfilePath())) {
+        UE_LOG(OSVRHMDDescriptionLog, Warning, TEXT("Could not save the display profile to %s."), *GetProfilePath(ProfileKey));
+        return false;
+    }
+    return true;
+}
+
+void OSVRHMDDescription::SetRenderTargetSize(const FIntPoint& Size)
+{
+    if (Data->RenderTargetSize != Size) {
+        Data->RenderTargetSize = Size;
+        if (Valid) {
+            SaveProfile();
+        }
+    }
+}
+
+FIntPoint OSVRHMDDescription::GetRenderTargetSize() const
+{
+    return Data->RenderTargetSize;
+}
+
 FVector2D OSVRHMDDescription::GetDisplaySize(EEye Eye) const
 {
     if (Eye == EEye::LEFT_EYE) {
@@ -221,13 +433,14 @@ FVector2D OSVRHMDDescription::GetFov(EEye Eye) const
 }
 
 // implemented to match the steamvr projection calculation but with OSVR calculated clipping planes.
-FMatrix OSVRHMDDescription::GetProjectionMatrix(EEye Eye, OSVR_DisplayConfig displayConfig) const
+FMatrix OSVRHMDDescription::GetProjectionMatrix(EEye Eye) const
 {
+    // clipping planes cached by InitFOV (or loaded from the profile)
     OSVR_EyeCount eye = (Eye == LEFT_EYE ? 0 : 1);
-    double left, right, bottom, top;
-    OSVR_ReturnCode rc;
-    rc = osvrClientGetViewerEyeSurfaceProjectionClippingPlanes(displayConfig, 0, eye, 0, &left, &right, &bottom, &top);
-    check(rc == OSVR_RETURN_SUCCESS);
+    const double left = Data->ClippingPlanes[eye][0];
+    const double right = Data->ClippingPlanes[eye][1];
+    const double bottom = Data->ClippingPlanes[eye][2];
+    const double top = Data->ClippingPlanes[eye][3];
 
     // The steam plugin inverts the clipping planes here, but that doesn't appear to
     // be necessary for the OSVR calculated planes.
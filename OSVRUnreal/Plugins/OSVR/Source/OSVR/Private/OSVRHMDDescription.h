@@ -27,7 +27,24 @@ struct DescriptionData
     FVector2D DisplaySize[2];
     FVector2D Fov[2];
 
+    /** Relative viewport of each eye surface: left, bottom, width, height */
+    int32 Viewport[2][4];
+
+    /** Projection clipping planes of each eye surface: left, right, bottom, top */
+    double ClippingPlanes[2][4];
+
+    /** Eye positions relative to the viewer, in OSVR space (meters) */
+    FVector EyePosition[2];
+
+    /** Render target size RenderManager asked for, zero if not known yet */
+    FIntPoint RenderTargetSize;
+
     DescriptionData();
+
+    /** @return True if the live-queried parts of the two descriptions match. */
+    bool MatchesDisplay(const DescriptionData& Other) const;
+
+    friend FArchive& operator<<(FArchive& Ar, DescriptionData& Data);
 };
 
 class OSVRHMDDescription
@@ -36,12 +53,45 @@ public:
 	OSVRHMDDescription();
 	~OSVRHMDDescription();
 
+    /**
+    * Queries the description from the display config. Doesn't save the
+    * profile, since that writes to disk and the queries run under the client
+    * context mutex; call SaveProfile once that's released.
+    */
 	bool Init(OSVR_ClientContext OSVRClientContext, OSVR_DisplayConfig displayConfig);
+
+    /** Saves the description as the display profile. Writes to disk. @return False if it couldn't be saved. */
+    bool SaveProfile() const;
 	bool IsValid() const
 	{
 		return Valid;
 	}
 
+    /**
+    * Loads the display profile saved by the last successful Init, so sizes and
+    * projections are known before the server answers. Init still has to
+    * validate it against the live display config.
+    *
+    * @return True if a profile was loaded.
+    */
+    bool LoadLastProfile();
+
+    /** @return True if the description comes from a saved profile that Init hasn't validated yet. */
+    bool IsFromProfile() const
+    {
+        return FromProfile;
+    }
+
+    /** @return True if there is a description to size things with, live or from a profile. */
+    bool HasDescription() const
+    {
+        return Valid || FromProfile;
+    }
+
+    /** Records the render target size RenderManager asked for, saving the profile if it changed. */
+    void SetRenderTargetSize(const FIntPoint& Size);
+    FIntPoint GetRenderTargetSize() const;
+
 	enum EEye
 	{
 		LEFT_EYE = 0,
@@ -53,9 +103,17 @@ public:
 	FVector2D GetFov(EEye Eye) const;
     FVector2D GetFov(OSVR_EyeCount Eye) const;
 	FVector GetLocation(EEye Eye) const;
-	FMatrix GetProjectionMatrix(EEye Eye, OSVR_DisplayConfig displayConfig) const;
+	FMatrix GetProjectionMatrix(EEye Eye) const;
     bool OSVRViewerFitsUnrealModel(OSVR_DisplayConfig displayConfig);
 
+    /**
+    * Queries the display config (of a new client context, after a reconnect)
+    * without touching this description or the saved profile.
+    *
+    * @return True if it describes the same display as this valid description.
+    */
+    bool MatchesDisplayConfig(OSVR_ClientContext OSVRClientContext, OSVR_DisplayConfig displayConfig) const;
+
 	// Helper function
 	// IPD    = ABS(GetLocation(LEFT_EYE).X - GetLocation(RIGHT_EYE).X);
 	float GetInterpupillaryDistance() const;
@@ -73,7 +131,15 @@ private:
     bool InitDisplaySize(OSVR_DisplayConfig displayConfig);
     bool InitFOV(OSVR_DisplayConfig displayConfig);
 
+    /** @return A key identifying the display descriptor, empty if it can't be read. */
+    static FString GetDisplayKey(OSVR_ClientContext OSVRClientContext);
+    static FString GetProfilePath(const FString& Key);
+    static FString GetLastProfilePath();
+    bool LoadProfile(const FString& Key, DescriptionData& OutData, float& OutIpd) const;
+
     float m_ipd;
 	bool Valid;
+    bool FromProfile = false;
+    FString ProfileKey;
     DescriptionData* Data;
 };
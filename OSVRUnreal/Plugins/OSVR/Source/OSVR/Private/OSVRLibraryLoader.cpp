@@ -0,0 +1,175 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRLibraryLoader.h"
+#include "Async/Async.h"
+
+namespace {
+    const TCHAR* const ConfigSection = TEXT("OSVR");
+    const TCHAR* const ConfigLibraryDirectoryKey = TEXT("LibraryDirectory");
+
+#if PLATFORM_WINDOWS
+#if PLATFORM_64BITS
+    const TCHAR* const PlatformDirectory = TEXT("Win64");
+#else
+    const TCHAR* const PlatformDirectory = TEXT("Win32");
+#endif
+    const TCHAR* const ClientKitChain[] = {
+        TEXT("osvrUtil.dll"),
+        TEXT("osvrCommon.dll"),
+        TEXT("osvrClient.dll"),
+        TEXT("osvrClientKit.dll")
+    };
+    // RenderManager's own dependencies don't depend on each other
+    const TCHAR* const RenderManagerDependencies[] = {
+        TEXT("d3dcompiler_47.dll"),
+        TEXT("glew32.dll"),
+        TEXT("SDL2.dll")
+    };
+    const TCHAR* const RenderManagerLibrary = TEXT("osvrRenderManager.dll");
+#elif PLATFORM_LINUX
+    const TCHAR* const PlatformDirectory = TEXT("Linux");
+    const TCHAR* const ClientKitChain[] = {
+        TEXT("libosvrUtil.so"),
+        TEXT("libosvrCommon.so"),
+        TEXT("libosvrClient.so"),
+        TEXT("libosvrClientKit.so")
+    };
+    // SDL2 and GLEW come from the system on Linux
+    const TCHAR* const RenderManagerLibrary = TEXT("libosvrRenderManager.so");
+#else
+#error "The OSVR plugin has no native libraries for this platform"
+#endif
+
+    TArray<FString> MakeChain(const TCHAR* const* Libraries, int32 Count)
+    {
+        TArray<FString> ret;
+        for (int32 i = 0; i < Count; i++) {
+            ret.Add(Libraries[i]);
+        }
+        return ret;
+    }
+}
+
+bool FOSVRLibraryLoader::ResolveLibraryDirectory()
+{
+    if (LibraryDirectory.Len() > 0) {
+        return true;
+    }
+    if (bResolveFailed) {
+        return false;
+    }
+
+    const FString clientKitLibrary = ClientKitChain[ARRAY_COUNT(ClientKitChain) - 1];
+
+    FString remembered;
+    if (GConfig->GetString(ConfigSection, ConfigLibraryDirectoryKey, remembered, GEngineIni)
+        && FPaths::FileExists(remembered / clientKitLibrary)) {
+        LibraryDirectory = remembered;
+        return true;
+    }
+
+    const FString pathsToTry[] = {
+        FPaths::GamePluginsDir() / TEXT("OSVR/Source/OSVRClientKit/bin") / PlatformDirectory,
+        FPaths::EngineDir() / TEXT("Plugins/Runtime/OSVR/Source/OSVRClientKit/bin") / PlatformDirectory,
+        FPaths::EngineDir() / TEXT("Binaries/ThirdParty/OSVRClientKit/bin") / PlatformDirectory,
+        FPaths::EngineDir() / TEXT("Source/ThirdParty/OSVRClientKit/bin") / PlatformDirectory
+    };
+    for (const FString& path : pathsToTry) {
+        if (FPaths::FileExists(path / clientKitLibrary)) {
+            LibraryDirectory = FPaths::ConvertRelativePathToFull(path) + TEXT("/");
+            GConfig->SetString(ConfigSection, ConfigLibraryDirectoryKey, *LibraryDirectory, GEngineIni);
+            GConfig->Flush(false, GEngineIni);
+            return true;
+        }
+    }
+
+    UE_LOG(OSVRLog, Warning, TEXT("Could not find OSVRClientKit module binaries in either the engine plugins or game plugins folder."));
+    bResolveFailed = true;
+    return false;
+}
+
+bool FOSVRLibraryLoader::LoadChain(const FString& Directory, const FLibraryChain& Chain)
+{
+    for (const FString& library : Chain) {
+        const FString path = Directory / library;
+        if (!FPlatformProcess::GetDllHandle(*path)) {
+            UE_LOG(OSVRLog, Warning, TEXT("FAILED to load %s"), *path);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FOSVRLibraryLoader::LoadChains(const TCHAR* GroupName, const TArray<FLibraryChain>& Chains)
+{
+    check(Chains.Num() > 0);
+    const double startTime = FPlatformTime::Seconds();
+
+    // The DLL search path is process wide, so it's set from here rather than
+    // from the load tasks, and only undone once they're all done.
+    FPlatformProcess::PushDllDirectory(*LibraryDirectory);
+
+    // all chains but the last on the thread pool, the last one on this thread
+    TArray<TFuture<bool>> loads;
+    const FString directory = LibraryDirectory;
+    for (int32 i = 0; i < Chains.Num() - 1; i++) {
+        const FLibraryChain chain = Chains[i];
+        loads.Add(Async<bool>(EAsyncExecution::ThreadPool, [directory, chain]() {
+            return LoadChain(directory, chain);
+        }));
+    }
+    bool bLoaded = LoadChain(directory, Chains.Last());
+    for (TFuture<bool>& load : loads) {
+        bLoaded = load.Get() && bLoaded;
+    }
+
+    FPlatformProcess::PopDllDirectory(*LibraryDirectory);
+
+    UE_LOG(OSVRLog, Log, TEXT("Loaded the OSVR %s libraries from %s in %.1f ms."),
+        GroupName, *LibraryDirectory, (FPlatformTime::Seconds() - startTime) * 1000.0);
+    return bLoaded;
+}
+
+bool FOSVRLibraryLoader::LoadClientKit()
+{
+    if (!bClientKitLoaded && ResolveLibraryDirectory()) {
+        TArray<FLibraryChain> chains;
+        chains.Add(MakeChain(ClientKitChain, ARRAY_COUNT(ClientKitChain)));
+        bClientKitLoaded = LoadChains(TEXT("ClientKit"), chains);
+    }
+    return bClientKitLoaded;
+}
+
+bool FOSVRLibraryLoader::LoadRenderManager()
+{
+    if (!bRenderManagerLoaded && LoadClientKit()) {
+        TArray<FLibraryChain> chains;
+#if PLATFORM_WINDOWS
+        for (int32 i = 0; i < ARRAY_COUNT(RenderManagerDependencies); i++) {
+            chains.Add(MakeChain(&RenderManagerDependencies[i], 1));
+        }
+        bRenderManagerLoaded = LoadChains(TEXT("RenderManager dependency"), chains);
+        chains.Reset();
+#else
+        bRenderManagerLoaded = true;
+#endif
+        chains.Add(MakeChain(&RenderManagerLibrary, 1));
+        bRenderManagerLoaded = bRenderManagerLoaded && LoadChains(TEXT("RenderManager"), chains);
+    }
+    return bRenderManagerLoaded;
+}
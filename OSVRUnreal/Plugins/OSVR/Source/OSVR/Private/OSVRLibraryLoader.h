@@ -0,0 +1,58 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+/**
+* Finds and loads the native OSVR libraries that the OSVRClientKit module
+* delay-loads (Windows) or links against (Linux).
+*
+* The directory holding them is looked up once and remembered in the engine
+* config, so later runs go straight to it. Libraries that don't depend on
+* each other are loaded concurrently on the thread pool. RenderManager and
+* its dependencies aren't needed until stereo rendering is requested, so
+* they're loaded separately, by LoadRenderManager(). On Linux the loader
+* resolves the libraries the module already links against, so this only
+* confirms they're there.
+*
+* Not synchronized; the owner serializes access.
+*/
+class FOSVRLibraryLoader
+{
+public:
+    /** @return True if the ClientKit libraries are loaded, loading them first if needed. */
+    bool LoadClientKit();
+
+    /** @return True if the RenderManager libraries are loaded, loading them (and ClientKit) first if needed. */
+    bool LoadRenderManager();
+
+private:
+    /** Libraries to load in order, each one possibly depending on the ones before it */
+    typedef TArray<FString> FLibraryChain;
+
+    /** Finds the directory holding the libraries, or returns the remembered one. */
+    bool ResolveLibraryDirectory();
+
+    /** Loads independent chains concurrently. @return True if every library loaded. */
+    bool LoadChains(const TCHAR* GroupName, const TArray<FLibraryChain>& Chains);
+
+    static bool LoadChain(const FString& Directory, const FLibraryChain& Chain);
+
+    FString LibraryDirectory;
+    bool bResolveFailed = false;
+    bool bClientKitLoaded = false;
+    bool bRenderManagerLoaded = false;
+};
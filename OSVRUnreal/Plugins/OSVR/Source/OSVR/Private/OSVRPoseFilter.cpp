@@ -0,0 +1,248 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRPoseFilter.h"
+
+namespace {
+    TAutoConsoleVariable<int32> CVarOSVRPoseFilter(
+        TEXT("osvr.PoseFilter"),
+        1,
+        TEXT("1 to filter tracker jitter out of the controller poses, and of the head pose if osvr.PoseFilterHead is set too."),
+        ECVF_Default);
+
+    TAutoConsoleVariable<int32> CVarOSVRPoseFilterHead(
+        TEXT("osvr.PoseFilterHead"),
+        0,
+        TEXT("1 to filter the head pose too. Off by default: the speed estimate needs a moment to catch up with the start of a head turn, which lags the view."),
+        ECVF_Default);
+
+    TAutoConsoleVariable<float> CVarOSVRPoseFilterMinCutoff(
+        TEXT("osvr.PoseFilterMinCutoff"),
+        1.0f,
+        TEXT("Cutoff frequency of the pose filter at rest, in Hz. Lower removes more jitter but lags slow motion more."),
+        ECVF_Default);
+
+    TAutoConsoleVariable<float> CVarOSVRPoseFilterPositionBeta(
+        TEXT("osvr.PoseFilterPositionBeta"),
+        10.0f,
+        TEXT("Increase of the pose filter cutoff frequency, in Hz, per m/s of linear speed."),
+        ECVF_Default);
+
+    TAutoConsoleVariable<float> CVarOSVRPoseFilterRotationBeta(
+        TEXT("osvr.PoseFilterRotationBeta"),
+        2.0f,
+        TEXT("Increase of the pose filter cutoff frequency, in Hz, per rad/s of angular speed."),
+        ECVF_Default);
+
+    // Cutoff of the low-pass on the speed estimate, in Hz
+    const float DerivativeCutoff = 1.0f;
+
+    // A gap longer than this means tracking dropped out; start over.
+    const double MaxSampleIntervalSeconds = 0.25;
+
+    // Keeps 1/dt finite for lanes without a new sample. Their alpha is zero anyway.
+    const float MinDeltaTime = 1.0e-6f;
+
+    /** Smoothing factor of a first order low-pass, from 2*pi*cutoff*dt */
+    FORCEINLINE VectorRegister LowPassAlpha(const VectorRegister& TwoPiCutoffDeltaTime)
+    {
+        return VectorMultiply(TwoPiCutoffDeltaTime, VectorReciprocal(VectorAdd(TwoPiCutoffDeltaTime, VectorOne())));
+    }
+}
+
+FOSVRPoseFilterParams FOSVRPoseFilterParams::FromConsoleVariables()
+{
+    FOSVRPoseFilterParams params;
+    params.MinCutoff = FMath::Max(CVarOSVRPoseFilterMinCutoff.GetValueOnAnyThread(), 0.01f);
+    params.PositionBeta = FMath::Max(CVarOSVRPoseFilterPositionBeta.GetValueOnAnyThread(), 0.0f);
+    params.RotationBeta = FMath::Max(CVarOSVRPoseFilterRotationBeta.GetValueOnAnyThread(), 0.0f);
+    return params;
+}
+
+FOSVRPoseFilterBank::FOSVRPoseFilterBank()
+{
+    SetParams(FOSVRPoseFilterParams());
+    Reset();
+}
+
+bool FOSVRPoseFilterBank::IsEnabled()
+{
+    return CVarOSVRPoseFilter.GetValueOnAnyThread() != 0;
+}
+
+bool FOSVRPoseFilterBank::IsEnabled(EOSVRTrackedPath Path)
+{
+    return IsEnabled() && (Path != TRACKED_PATH_HEAD || CVarOSVRPoseFilterHead.GetValueOnAnyThread() != 0);
+}
+
+void FOSVRPoseFilterBank::Reset()
+{
+    OSVR_Pose3 identity;
+    osvrPose3SetIdentity(&identity);
+    const OSVR_TimeValue zero = { 0, 0 };
+    for (int32 lane = 0; lane < NumLanes; lane++) {
+        // unused lanes too, so normalizing them doesn't produce NaNs
+        ResetLane(lane, zero, identity);
+        bHasSample[lane] = false;
+    }
+}
+
+void FOSVRPoseFilterBank::SetParams(EOSVRTrackedPath Path, const FOSVRPoseFilterParams& Params)
+{
+    check(Path >= 0 && Path < TRACKED_PATH_COUNT);
+    MinCutoff.Values[Path] = Params.MinCutoff;
+    PositionBeta.Values[Path] = Params.PositionBeta;
+    RotationBeta.Values[Path] = Params.RotationBeta;
+}
+
+void FOSVRPoseFilterBank::SetParams(const FOSVRPoseFilterParams& Params)
+{
+    for (int32 lane = 0; lane < NumLanes; lane++) {
+        MinCutoff.Values[lane] = Params.MinCutoff;
+        PositionBeta.Values[lane] = Params.PositionBeta;
+        RotationBeta.Values[lane] = Params.RotationBeta;
+    }
+}
+
+void FOSVRPoseFilterBank::ResetLane(int32 Lane, const OSVR_TimeValue& Timestamp, const OSVR_Pose3& Pose)
+{
+    SetRawPose(Lane, Pose);
+    for (int32 channel = 0; channel < CHANNEL_COUNT; channel++) {
+        Filtered[channel].Values[Lane] = Raw[channel].Values[Lane];
+    }
+    PositionSpeed.Values[Lane] = 0.0f;
+    RotationSpeed.Values[Lane] = 0.0f;
+    DeltaTime.Values[Lane] = 0.0f;
+    LastTimestamp[Lane] = Timestamp;
+    bHasSample[Lane] = true;
+}
+
+void FOSVRPoseFilterBank::SetRawPose(int32 Lane, const OSVR_Pose3& Pose)
+{
+    Raw[CHANNEL_POSITION_X].Values[Lane] = static_cast<float>(osvrVec3GetX(&Pose.translation));
+    Raw[CHANNEL_POSITION_Y].Values[Lane] = static_cast<float>(osvrVec3GetY(&Pose.translation));
+    Raw[CHANNEL_POSITION_Z].Values[Lane] = static_cast<float>(osvrVec3GetZ(&Pose.translation));
+    Raw[CHANNEL_ROTATION_X].Values[Lane] = static_cast<float>(osvrQuatGetX(&Pose.rotation));
+    Raw[CHANNEL_ROTATION_Y].Values[Lane] = static_cast<float>(osvrQuatGetY(&Pose.rotation));
+    Raw[CHANNEL_ROTATION_Z].Values[Lane] = static_cast<float>(osvrQuatGetZ(&Pose.rotation));
+    Raw[CHANNEL_ROTATION_W].Values[Lane] = static_cast<float>(osvrQuatGetW(&Pose.rotation));
+}
+
+void FOSVRPoseFilterBank::AddSample(EOSVRTrackedPath Path, const OSVR_TimeValue& Timestamp, const OSVR_Pose3& Pose)
+{
+    check(Path >= 0 && Path < TRACKED_PATH_COUNT);
+    const int32 lane = Path;
+    if (!bHasSample[lane]) {
+        ResetLane(lane, Timestamp, Pose);
+        return;
+    }
+
+    const double dt = osvrTimeValueDurationSeconds(&Timestamp, &LastTimestamp[lane]);
+    if (dt <= 0.0) {
+        return;
+    }
+    if (dt > MaxSampleIntervalSeconds) {
+        ResetLane(lane, Timestamp, Pose);
+        return;
+    }
+
+    SetRawPose(lane, Pose);
+
+    // q and -q are the same rotation; filter towards whichever is closer.
+    float dot = 0.0f;
+    for (int32 channel = CHANNEL_ROTATION_X; channel <= CHANNEL_ROTATION_W; channel++) {
+        dot += Raw[channel].Values[lane] * Filtered[channel].Values[lane];
+    }
+    if (dot < 0.0f) {
+        for (int32 channel = CHANNEL_ROTATION_X; channel <= CHANNEL_ROTATION_W; channel++) {
+            Raw[channel].Values[lane] = -Raw[channel].Values[lane];
+        }
+    }
+
+    DeltaTime.Values[lane] = static_cast<float>(dt);
+    LastTimestamp[lane] = Timestamp;
+}
+
+void FOSVRPoseFilterBank::Filter()
+{
+    const VectorRegister deltaTime = VectorLoadAligned(DeltaTime.Values);
+    const VectorRegister invDeltaTime = VectorReciprocal(VectorMax(deltaTime, VectorSetFloat1(MinDeltaTime)));
+    const VectorRegister twoPiDeltaTime = VectorMultiply(deltaTime, VectorSetFloat1(2.0f * PI));
+    const VectorRegister derivativeAlpha = LowPassAlpha(VectorMultiply(twoPiDeltaTime, VectorSetFloat1(DerivativeCutoff)));
+
+    FilterChannels(CHANNEL_POSITION_X, 3, 1.0f, PositionSpeed, PositionBeta, twoPiDeltaTime, invDeltaTime, derivativeAlpha);
+
+    // for small rotations, the angle is about twice the length of the quaternion difference
+    FilterChannels(CHANNEL_ROTATION_X, 4, 2.0f, RotationSpeed, RotationBeta, twoPiDeltaTime, invDeltaTime, derivativeAlpha);
+
+    // renormalize the filtered rotations
+    VectorRegister rotation[4];
+    VectorRegister lengthSquared = VectorZero();
+    for (int32 i = 0; i < 4; i++) {
+        rotation[i] = VectorLoadAligned(Filtered[CHANNEL_ROTATION_X + i].Values);
+        lengthSquared = VectorMultiplyAdd(rotation[i], rotation[i], lengthSquared);
+    }
+    const VectorRegister invLength = VectorReciprocalSqrt(lengthSquared);
+    for (int32 i = 0; i < 4; i++) {
+        VectorStoreAligned(VectorMultiply(rotation[i], invLength), Filtered[CHANNEL_ROTATION_X + i].Values);
+    }
+
+    // consumed; filtering again without new samples changes nothing
+    VectorStoreAligned(VectorZero(), DeltaTime.Values);
+}
+
+void FOSVRPoseFilterBank::FilterChannels(int32 First, int32 Count, float SpeedScale, FLanes& Speed, const FLanes& Beta,
+    VectorRegister TwoPiDeltaTime, VectorRegister InvDeltaTime, VectorRegister DerivativeAlpha)
+{
+    check(Count <= 4);
+    VectorRegister delta[4];
+    VectorRegister lengthSquared = VectorZero();
+    for (int32 i = 0; i < Count; i++) {
+        delta[i] = VectorSubtract(VectorLoadAligned(Raw[First + i].Values), VectorLoadAligned(Filtered[First + i].Values));
+        lengthSquared = VectorMultiplyAdd(delta[i], delta[i], lengthSquared);
+    }
+
+    // sqrt(x) as x / sqrt(x), kept finite at zero
+    const VectorRegister length = VectorMultiply(lengthSquared,
+        VectorReciprocalSqrt(VectorMax(lengthSquared, VectorSetFloat1(SMALL_NUMBER))));
+    const VectorRegister speed = VectorMultiply(VectorMultiply(length, InvDeltaTime), VectorSetFloat1(SpeedScale));
+
+    const VectorRegister previousSpeed = VectorLoadAligned(Speed.Values);
+    const VectorRegister smoothedSpeed = VectorMultiplyAdd(DerivativeAlpha, VectorSubtract(speed, previousSpeed), previousSpeed);
+    VectorStoreAligned(smoothedSpeed, Speed.Values);
+
+    const VectorRegister cutoff = VectorMultiplyAdd(VectorLoadAligned(Beta.Values), smoothedSpeed, VectorLoadAligned(MinCutoff.Values));
+    const VectorRegister alpha = LowPassAlpha(VectorMultiply(TwoPiDeltaTime, cutoff));
+
+    for (int32 i = 0; i < Count; i++) {
+        const VectorRegister filtered = VectorLoadAligned(Filtered[First + i].Values);
+        VectorStoreAligned(VectorMultiplyAdd(alpha, delta[i], filtered), Filtered[First + i].Values);
+    }
+}
+
+void FOSVRPoseFilterBank::GetFilteredPose(EOSVRTrackedPath Path, OSVR_Pose3& OutPose) const
+{
+    check(Path >= 0 && Path < TRACKED_PATH_COUNT);
+    const int32 lane = Path;
+    osvrVec3SetX(&OutPose.translation, Filtered[CHANNEL_POSITION_X].Values[lane]);
+    osvrVec3SetY(&OutPose.translation, Filtered[CHANNEL_POSITION_Y].Values[lane]);
+    osvrVec3SetZ(&OutPose.translation, Filtered[CHANNEL_POSITION_Z].Values[lane]);
+    osvrQuatSetX(&OutPose.rotation, Filtered[CHANNEL_ROTATION_X].Values[lane]);
+    osvrQuatSetY(&OutPose.rotation, Filtered[CHANNEL_ROTATION_Y].Values[lane]);
+    osvrQuatSetZ(&OutPose.rotation, Filtered[CHANNEL_ROTATION_Z].Values[lane]);
+    osvrQuatSetW(&OutPose.rotation, Filtered[CHANNEL_ROTATION_W].Values[lane]);
+}
@@ -0,0 +1,129 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include "OSVRTypes.h"
+
+#include <osvr/Util/Pose3C.h>
+#include <osvr/Util/TimeValueC.h>
+
+/** Tuning of the adaptive filter for one tracked path. */
+struct FOSVRPoseFilterParams
+{
+    /** Cutoff frequency at rest, in Hz. Lower removes more jitter but lags slow motion more. */
+    float MinCutoff = 1.0f;
+
+    /** Cutoff increase, in Hz, per m/s of linear speed */
+    float PositionBeta = 10.0f;
+
+    /** Cutoff increase, in Hz, per rad/s of angular speed */
+    float RotationBeta = 2.0f;
+
+    /** @return The params set by the osvr.PoseFilter* console variables. */
+    static FOSVRPoseFilterParams FromConsoleVariables();
+};
+
+/**
+* One-Euro style adaptive low-pass filter for the poses of all tracked paths.
+*
+* The cutoff frequency rises with the (smoothed) speed of each path, so jitter
+* at rest is removed while fast motion passes through with almost no lag.
+* Poses are kept in structure-of-arrays form, one SIMD lane per tracked path,
+* and Filter() processes every path with new samples in a single pass.
+* Poses are raw OSVR poses, before conversion to Unreal space.
+*
+* Not synchronized; the owner serializes access.
+*/
+class FOSVRPoseFilterBank
+{
+public:
+    FOSVRPoseFilterBank();
+
+    /** @return True if pose filtering is enabled in the config, for any path. */
+    static bool IsEnabled();
+
+    /** @return True if the poses of Path are to be filtered, see osvr.PoseFilterHead. */
+    static bool IsEnabled(EOSVRTrackedPath Path);
+
+    /** Forgets the state of all paths. */
+    void Reset();
+
+    void SetParams(EOSVRTrackedPath Path, const FOSVRPoseFilterParams& Params);
+
+    /** Sets the same params for all paths. */
+    void SetParams(const FOSVRPoseFilterParams& Params);
+
+    /**
+    * Stages a raw sample for the next Filter(). A sample that isn't newer than
+    * the previous one for the path leaves the path unchanged.
+    */
+    void AddSample(EOSVRTrackedPath Path, const OSVR_TimeValue& Timestamp, const OSVR_Pose3& Pose);
+
+    /** Filters all staged samples. */
+    void Filter();
+
+    void GetFilteredPose(EOSVRTrackedPath Path, OSVR_Pose3& OutPose) const;
+
+private:
+    static const int32 NumLanes = 4;
+    static_assert(TRACKED_PATH_COUNT <= NumLanes, "One SIMD lane per tracked path");
+
+    enum EChannel
+    {
+        CHANNEL_POSITION_X = 0,
+        CHANNEL_POSITION_Y,
+        CHANNEL_POSITION_Z,
+        CHANNEL_ROTATION_X,
+        CHANNEL_ROTATION_Y,
+        CHANNEL_ROTATION_Z,
+        CHANNEL_ROTATION_W,
+        CHANNEL_COUNT
+    };
+
+    /** One value per lane */
+    MS_ALIGN(16) struct FLanes
+    {
+        float Values[NumLanes];
+    } GCC_ALIGN(16);
+
+    void ResetLane(int32 Lane, const OSVR_TimeValue& Timestamp, const OSVR_Pose3& Pose);
+    void SetRawPose(int32 Lane, const OSVR_Pose3& Pose);
+
+    /**
+    * Filters the Count channels starting at First as one vector per lane.
+    * Speed is that vector's rate of change, times SpeedScale.
+    */
+    void FilterChannels(int32 First, int32 Count, float SpeedScale, FLanes& Speed, const FLanes& Beta,
+        VectorRegister TwoPiDeltaTime, VectorRegister InvDeltaTime, VectorRegister DerivativeAlpha);
+
+    FLanes Raw[CHANNEL_COUNT];
+    FLanes Filtered[CHANNEL_COUNT];
+
+    /** Smoothed linear (m/s) and angular (rad/s) speed */
+    FLanes PositionSpeed;
+    FLanes RotationSpeed;
+
+    /** Seconds since the previous sample; zero for lanes without a new sample */
+    FLanes DeltaTime;
+
+    FLanes MinCutoff;
+    FLanes PositionBeta;
+    FLanes RotationBeta;
+
+    OSVR_TimeValue LastTimestamp[NumLanes];
+    bool bHasSample[NumLanes];
+};
@@ -0,0 +1,126 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <osvr/Util/TimeValueC.h>
+
+/**
+* Fixed-capacity ring buffer of timestamped poses, oldest entries overwritten
+* first. Never allocates. Not synchronized; the owner serializes access.
+*/
+template<int32 Capacity>
+class TOSVRPoseHistory
+{
+public:
+    struct FEntry
+    {
+        OSVR_TimeValue Timestamp;
+        FQuat Orientation;
+        FVector Position;
+    };
+
+    TOSVRPoseHistory() :
+        Oldest(0),
+        Count(0)
+    {
+    }
+
+    void Reset()
+    {
+        Oldest = 0;
+        Count = 0;
+    }
+
+    int32 Num() const
+    {
+        return Count;
+    }
+
+    /** Adds a pose. Poses that aren't newer than the newest entry are dropped. */
+    void Add(const OSVR_TimeValue& Timestamp, const FQuat& Orientation, const FVector& Position)
+    {
+        if (Count > 0 && osvrTimeValueCmp(&Timestamp, &At(Count - 1).Timestamp) <= 0) {
+            return;
+        }
+
+        FEntry* entry;
+        if (Count < Capacity) {
+            entry = &Entries[(Oldest + Count) % Capacity];
+            Count++;
+        } else {
+            entry = &Entries[Oldest];
+            Oldest = (Oldest + 1) % Capacity;
+        }
+        entry->Timestamp = Timestamp;
+        entry->Orientation = Orientation;
+        entry->Position = Position;
+    }
+
+    /**
+    * Gets the pose at an arbitrary time: slerp for rotation, lerp for position
+    * between the two entries around Time, found by binary search. Times newer
+    * than the newest entry return the newest entry; there is no extrapolation.
+    *
+    * @return False if the history is empty or Time is older than the oldest entry.
+    */
+    bool GetPoseAtTime(const OSVR_TimeValue& Time, FQuat& OutOrientation, FVector& OutPosition) const
+    {
+        if (Count == 0) {
+            return false;
+        }
+
+        // first entry newer than Time
+        int32 low = 0;
+        int32 high = Count;
+        while (low < high) {
+            const int32 mid = low + (high - low) / 2;
+            if (osvrTimeValueCmp(&At(mid).Timestamp, &Time) <= 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        if (low == 0) {
+            return false;
+        }
+        if (low == Count) {
+            OutOrientation = At(Count - 1).Orientation;
+            OutPosition = At(Count - 1).Position;
+            return true;
+        }
+
+        const FEntry& before = At(low - 1);
+        const FEntry& after = At(low);
+        const double span = osvrTimeValueDurationSeconds(&after.Timestamp, &before.Timestamp);
+        const float alpha = static_cast<float>(osvrTimeValueDurationSeconds(&Time, &before.Timestamp) / span);
+        OutOrientation = FQuat::Slerp(before.Orientation, after.Orientation, alpha);
+        OutPosition = FMath::Lerp(before.Position, after.Position, alpha);
+        return true;
+    }
+
+private:
+    /** @param Index 0 for the oldest entry, Count - 1 for the newest */
+    const FEntry& At(int32 Index) const
+    {
+        return Entries[(Oldest + Index) % Capacity];
+    }
+
+    FEntry Entries[Capacity];
+    int32 Oldest;
+    int32 Count;
+};
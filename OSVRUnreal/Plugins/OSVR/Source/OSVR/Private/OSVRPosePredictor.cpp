@@ -0,0 +1,135 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRPosePredictor.h"
+
+namespace {
+    // Samples closer together than this are too noisy to differentiate.
+    const double MinSampleIntervalSeconds = 0.0005;
+
+    // A gap longer than this means tracking dropped out; start over.
+    const double MaxSampleIntervalSeconds = 0.1;
+
+    // Never extrapolate further than this, whatever the caller asks for.
+    const double MaxExtrapolationSeconds = 0.1;
+
+    // Faster than any real head or hand; anything above is tracker noise.
+    const float MaxLinearSpeed = 5.0f;        // m/s
+    const float MaxAngularSpeed = 4.0f * PI;  // rad/s
+
+    // Weight of the newest instantaneous velocity in the smoothed estimate.
+    const float VelocitySmoothing = 0.5f;
+
+    FVector ClampLength(const FVector& Vector, float MaxLength)
+    {
+        const float lengthSquared = Vector.SizeSquared();
+        if (lengthSquared > FMath::Square(MaxLength)) {
+            return Vector * (MaxLength / FMath::Sqrt(lengthSquared));
+        }
+        return Vector;
+    }
+}
+
+FOSVRPosePredictor::FOSVRPosePredictor()
+{
+    Reset();
+}
+
+void FOSVRPosePredictor::Reset()
+{
+    LastTimestamp.seconds = 0;
+    LastTimestamp.microseconds = 0;
+    LastOrientation = FQuat::Identity;
+    LastPosition = FVector::ZeroVector;
+    bHasSample = false;
+
+    LinearVelocity = FVector::ZeroVector;
+    AngularVelocity = FVector::ZeroVector;
+    bHasVelocity = false;
+}
+
+void FOSVRPosePredictor::AddSample(const OSVR_TimeValue& Timestamp, const FQuat& Orientation, const FVector& Position)
+{
+    if (bHasSample) {
+        const double dt = osvrTimeValueDurationSeconds(&Timestamp, &LastTimestamp);
+        if (dt < MinSampleIntervalSeconds) {
+            return;
+        }
+
+        if (dt > MaxSampleIntervalSeconds) {
+            LinearVelocity = FVector::ZeroVector;
+            AngularVelocity = FVector::ZeroVector;
+            bHasVelocity = false;
+        } else {
+            const FVector linearVelocity = ClampLength((Position - LastPosition) / dt, MaxLinearSpeed);
+
+            // world-space delta rotation, shortest arc
+            FQuat delta = Orientation * LastOrientation.Inverse();
+            if (delta.W < 0.0f) {
+                delta = delta * -1.0f;
+            }
+            delta.Normalize();
+            FVector axis;
+            float angle;
+            delta.ToAxisAndAngle(axis, angle);
+            const FVector angularVelocity = ClampLength(axis * (angle / dt), MaxAngularSpeed);
+
+            if (bHasVelocity) {
+                LinearVelocity = FMath::Lerp(LinearVelocity, linearVelocity, VelocitySmoothing);
+                AngularVelocity = FMath::Lerp(AngularVelocity, angularVelocity, VelocitySmoothing);
+            } else {
+                LinearVelocity = linearVelocity;
+                AngularVelocity = angularVelocity;
+                bHasVelocity = true;
+            }
+        }
+    }
+
+    LastTimestamp = Timestamp;
+    LastOrientation = Orientation;
+    LastPosition = Position;
+    bHasSample = true;
+}
+
+bool FOSVRPosePredictor::Predict(const OSVR_TimeValue& TargetTime, FQuat& OutOrientation, FVector& OutPosition) const
+{
+    if (!bHasSample) {
+        return false;
+    }
+    Extrapolate(LastTimestamp, LastOrientation, LastPosition, TargetTime, OutOrientation, OutPosition);
+    return true;
+}
+
+void FOSVRPosePredictor::Extrapolate(const OSVR_TimeValue& SampleTime, const FQuat& Orientation, const FVector& Position,
+    const OSVR_TimeValue& TargetTime, FQuat& OutOrientation, FVector& OutPosition) const
+{
+    OutOrientation = Orientation;
+    OutPosition = Position;
+    if (!bHasVelocity) {
+        return;
+    }
+
+    const float dt = static_cast<float>(FMath::Clamp(osvrTimeValueDurationSeconds(&TargetTime, &SampleTime), 0.0, MaxExtrapolationSeconds));
+    OutPosition = Position + LinearVelocity * dt;
+
+    const float angularSpeed = AngularVelocity.Size();
+    if (angularSpeed > KINDA_SMALL_NUMBER) {
+        const FQuat delta(AngularVelocity / angularSpeed, angularSpeed * dt);
+        OutOrientation = delta * Orientation;
+        OutOrientation.Normalize();
+    }
+}
@@ -0,0 +1,70 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <osvr/Util/TimeValueC.h>
+
+/**
+* Constant-velocity pose predictor.
+*
+* Linear and angular velocity are estimated from consecutive timestamped
+* samples and smoothed, then used to extrapolate a pose forward in time.
+* Samples are in Unreal axes but otherwise raw (meters, not base-relative).
+* The object is plain data, so a copy can be handed to another thread to
+* extrapolate with the same velocity estimate.
+*/
+class FOSVRPosePredictor
+{
+public:
+    FOSVRPosePredictor();
+
+    /** Forgets all samples and the velocity estimate. */
+    void Reset();
+
+    /**
+    * Adds a sample. Samples that aren't newer than the last one (e.g. the same
+    * report sampled again) are ignored.
+    */
+    void AddSample(const OSVR_TimeValue& Timestamp, const FQuat& Orientation, const FVector& Position);
+
+    /** Extrapolates the latest sample to TargetTime. @return false if there is no sample yet. */
+    bool Predict(const OSVR_TimeValue& TargetTime, FQuat& OutOrientation, FVector& OutPosition) const;
+
+    /**
+    * Extrapolates an arbitrary sample to TargetTime using the current velocity
+    * estimate. If there is no estimate yet, the sample is returned unchanged.
+    */
+    void Extrapolate(const OSVR_TimeValue& SampleTime, const FQuat& Orientation, const FVector& Position,
+        const OSVR_TimeValue& TargetTime, FQuat& OutOrientation, FVector& OutPosition) const;
+
+    bool HasVelocity() const
+    {
+        return bHasVelocity;
+    }
+
+private:
+    OSVR_TimeValue LastTimestamp;
+    FQuat LastOrientation;
+    FVector LastPosition;
+    bool bHasSample;
+
+    /** meters per second */
+    FVector LinearVelocity;
+    /** world-space rotation axis scaled by radians per second */
+    FVector AngularVelocity;
+    bool bHasVelocity;
+};
@@ -23,6 +23,16 @@
 #include "Runtime/Renderer/Private/PostProcess/PostProcessHMD.h"
 #include "Runtime/Engine/Public/ScreenRendering.h"
 
+namespace {
+    TAutoConsoleVariable<int32> CVarOSVRLateLatching(
+        TEXT("osvr.LateLatching"),
+        1,
+        TEXT("1 to re-sample the head pose on the render thread just before the views are drawn.\n")
+        TEXT("Reads the poses the tracking thread publishes, so it starts the tracking thread when the HMD connects."),
+        ECVF_Default);
+
+}
+
 void FOSVRHMD::DrawDistortionMesh_RenderThread(FRenderingCompositePassContext& Context, const FIntPoint& TextureSize)
 {
     // shouldn't be called with a custom present
@@ -34,36 +44,63 @@ void FOSVRHMD::RenderTexture_RenderThread(FRHICommandListImmediate& rhiCmdList,
 {
     check(IsInRenderingThread());
     if (GIsEditor || !mCustomPresent || !mCustomPresent->IsInitialized()) {
-        const uint32 viewportWidth = backBuffer->GetSizeX();
-        const uint32 viewportHeight = backBuffer->GetSizeY();
-
-        SetRenderTarget(rhiCmdList, backBuffer, FTextureRHIRef());
-        rhiCmdList.SetViewport(0, 0, 0, viewportWidth, viewportHeight, 1.0f);
-
-        rhiCmdList.SetBlendState(TStaticBlendState<>::GetRHI());
-        rhiCmdList.SetRasterizerState(TStaticRasterizerState<>::GetRHI());
-        rhiCmdList.SetDepthStencilState(TStaticDepthStencilState<false, CF_Always>::GetRHI());
-
-        const auto featureLevel = GMaxRHIFeatureLevel;
-        auto shaderMap = GetGlobalShaderMap(featureLevel);
-
-        TShaderMapRef<FScreenVS> vertexShader(shaderMap);
-        TShaderMapRef<FScreenPS> pixelShader(shaderMap);
-
-        static FGlobalBoundShaderState boundShaderState;
-        SetGlobalBoundShaderState(rhiCmdList, featureLevel, boundShaderState, RendererModule->GetFilterVertexDeclaration().VertexDeclarationRHI, *vertexShader, *pixelShader);
-
-        pixelShader->SetParameters(rhiCmdList, TStaticSamplerState<SF_Bilinear>::GetRHI(), srcTexture);
-        RendererModule->DrawRectangle(
-            rhiCmdList,
-            0, 0, // X, Y
-            viewportWidth, viewportHeight, // SizeX, SizeY
-            0.0f, 0.0f, // U, V
-            1.0f, 1.0f, // SizeU, SizeV
-            FIntPoint(viewportWidth, viewportHeight), // TargetSize
-            FIntPoint(1, 1), // TextureSize
-            *vertexShader,
-            EDRF_Default);
+        DrawMirror_RenderThread(rhiCmdList, backBuffer, srcTexture);
+    }
+    // last thing rendered in the frame
+    FramePacer.EndFrame_RenderThread(rhiCmdList);
+}
+
+void FOSVRHMD::DrawMirror_RenderThread(FRHICommandListImmediate& rhiCmdList, FTexture2DRHIParamRef target, FTextureRHIParamRef srcTexture) const
+{
+    check(IsInRenderingThread());
+    const uint32 viewportWidth = target->GetSizeX();
+    const uint32 viewportHeight = target->GetSizeY();
+
+    SetRenderTarget(rhiCmdList, target, FTextureRHIRef());
+    rhiCmdList.SetViewport(0, 0, 0, viewportWidth, viewportHeight, 1.0f);
+
+    rhiCmdList.SetBlendState(TStaticBlendState<>::GetRHI());
+    rhiCmdList.SetRasterizerState(TStaticRasterizerState<>::GetRHI());
+    rhiCmdList.SetDepthStencilState(TStaticDepthStencilState<false, CF_Always>::GetRHI());
+
+    const auto featureLevel = GMaxRHIFeatureLevel;
+    auto shaderMap = GetGlobalShaderMap(featureLevel);
+
+    TShaderMapRef<FScreenVS> vertexShader(shaderMap);
+    TShaderMapRef<FScreenPS> pixelShader(shaderMap);
+
+    SetGlobalBoundShaderState(rhiCmdList, featureLevel, MirrorBoundShaderState, RendererModule->GetFilterVertexDeclaration().VertexDeclarationRHI, *vertexShader, *pixelShader);
+
+    pixelShader->SetParameters(rhiCmdList, TStaticSamplerState<SF_Bilinear>::GetRHI(), srcTexture);
+    RendererModule->DrawRectangle(
+        rhiCmdList,
+        0, 0, // X, Y
+        viewportWidth, viewportHeight, // SizeX, SizeY
+        0.0f, 0.0f, // U, V
+        1.0f, 1.0f, // SizeU, SizeV
+        FIntPoint(viewportWidth, viewportHeight), // TargetSize
+        FIntPoint(1, 1), // TextureSize
+        *vertexShader,
+        EDRF_Default);
+}
+
+void FOSVRHMD::WarmUp_RenderThread(FRHICommandListImmediate& rhiCmdList)
+{
+    check(IsInRenderingThread());
+    if (!mCustomPresent) {
+        return;
+    }
+    FTexture2DRHIRef target = mCustomPresent->AllocateWarmUpTarget_RenderThread();
+    if (!IsValidRef(target)) {
+        return;
+    }
+
+    // Binds the mirror shaders for the first time, and clears the target to black while at it.
+    DrawMirror_RenderThread(rhiCmdList, target, GBlackTexture->TextureRHI);
+    rhiCmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+    if (mCustomPresent->PresentWarmUpFrame_RenderThread()) {
+        UE_LOG(OSVRHMDLog, Log, TEXT("Warmed up the render target and RenderManager with a black frame."));
     }
 }
 
@@ -89,23 +126,92 @@ void FOSVRHMD::GetEyeRenderParams_RenderThread(const struct FRenderingCompositeP
 
 void FOSVRHMD::GetTimewarpMatrices_RenderThread(const struct FRenderingCompositePassContext& Context, FMatrix& EyeRotationStart, FMatrix& EyeRotationEnd) const
 {
-	// intentionally left blank
+    // intentionally left blank: RenderManager does the time warp, with the
+    // pose the frame was rendered with (see SetRenderHeadPose)
 }
 
-// @todo: Why is this function never called?
+void FOSVRHMD::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+    check(IsInGameThread());
+    FRenderThreadFrame frame;
+    frame.BaseOrientation = BaseOrientation;
+    frame.BasePosition = BasePosition;
+    frame.DeltaControlOrientation = PoseState.DeltaControlOrientation;
+    frame.WorldToMetersScale = WorldToMetersScale;
+    frame.InterpupillaryDistance = GetInterpupillaryDistance();
+    frame.bLateLatch = HeadPose.bValid && CVarOSVRLateLatching.GetValueOnGameThread() != 0;
+    if (frame.bLateLatch && !IOSVR::Get().GetTrackingThread() && !bLoggedLateLatchInert) {
+        // the render thread never pumps the client context itself
+        UE_LOG(OSVRHMDLog, Warning, TEXT("osvr.LateLatching is on, but the tracking thread isn't running, so the head pose is not late-latched. ")
+            TEXT("It's started when the HMD connects with osvr.LateLatching on."));
+        bLoggedLateLatchInert = true;
+    }
+    frame.HeadPose = HeadPose;
+    frame.HeadPosePredictor = HeadPosePredictor;
+    frame.PredictionHorizon = PredictionHorizon;
+
+    ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(OSVRSetRenderThreadFrame,
+        FOSVRHMD*, HMD, this,
+        FRenderThreadFrame, Frame, frame,
+        {
+            HMD->RenderThreadFrame = Frame;
+        });
+}
+
+// Called by the renderer for every view family drawn in stereo: the game
+// viewport adds GetViewExtension() to the family's ViewExtensions.
 void FOSVRHMD::PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& ViewFamily)
 {
     check(IsInRenderingThread());
+
+    // Before the late latch, so the pose is sampled as late as the GPU allows.
+    FramePacer.WaitForFramesInFlight_RenderThread();
+
+    // Late latch: one fresh pose for the whole family, so both eyes agree.
+    LatchedHeadPose.bValid = false;
+    if (RenderThreadFrame.bLateLatch) {
+        OSVR_Pose3 pose;
+        if (SampleViewerPose_RenderThread(pose, LatchedHeadPose.Timestamp)) {
+            // predicted with the game thread's velocity estimate, otherwise the
+            // delta would take the game thread's prediction back out again
+            PredictRawPose(nullptr, RenderThreadFrame.HeadPosePredictor, RenderThreadFrame.PredictionHorizon,
+                pose, LatchedHeadPose.Timestamp, LatchedHeadPose.RawPose, LatchedHeadPose.PredictedTime);
+            ToBaseRelativePose(LatchedHeadPose.RawPose, RenderThreadFrame.BaseOrientation, RenderThreadFrame.BasePosition,
+                RenderThreadFrame.WorldToMetersScale, LatchedHeadPose.Orientation, LatchedHeadPose.Position);
+            LatchedHeadPose.FrameNumber = ViewFamily.FrameNumber;
+            LatchedHeadPose.bValid = true;
+        }
+    }
+    RenderedHeadPose = LatchedHeadPose.bValid ? LatchedHeadPose : RenderThreadFrame.HeadPose;
     if (mCustomPresent) {
-        mCustomPresent->Initialize();
+        mCustomPresent->SetRenderHeadPose(RenderedHeadPose.bValid ? &RenderedHeadPose.RawPose : nullptr);
     }
-    // steamVR updates the current pose here, should we?
 }
 
 void FOSVRHMD::PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& View)
 {
-    // @todo
+    check(IsInRenderingThread());
+    if (!LatchedHeadPose.bValid) {
+        return;
+    }
+
+    // The view was set up on the game thread with the pose in BaseHmdOrientation/BaseHmdLocation.
+    // Apply only the delta to the late-latched pose, so cameras driven by other game objects keep working.
+    const FQuat oldViewOrientation = View.ViewRotation.Quaternion();
+    const FQuat deltaOrientation = View.BaseHmdOrientation.Inverse() * LatchedHeadPose.Orientation;
+    const FQuat newViewOrientation = oldViewOrientation * deltaOrientation;
+
+    FVector deltaLocation = RenderThreadFrame.DeltaControlOrientation.RotateVector(LatchedHeadPose.Position - View.BaseHmdLocation);
+    if (View.StereoPass != eSSP_FULL) {
+        // the eye offset was applied in the old view orientation
+        const float eyeOffset = (RenderThreadFrame.InterpupillaryDistance * View.WorldToMetersScale) / 2.0f;
+        const FVector passOffset(0, View.StereoPass == eSSP_LEFT_EYE ? -eyeOffset : eyeOffset, 0);
+        deltaLocation += newViewOrientation.RotateVector(passOffset) - oldViewOrientation.RotateVector(passOffset);
+    }
 
+    View.ViewRotation = FRotator(newViewOrientation);
+    View.ViewLocation += deltaLocation;
+    View.UpdateViewMatrix();
 }
 
 void FOSVRHMD::CalculateRenderTargetSize(const FViewport& Viewport, uint32& InOutSizeX, uint32& InOutSizeY)
@@ -117,12 +223,15 @@ void FOSVRHMD::CalculateRenderTargetSize(const FViewport& Viewport, uint32& InOu
     }
 
     if (mCustomPresent) {
-        if (!mCustomPresent->IsInitialized() && IsInRenderingThread() && !mCustomPresent->Initialize()) {
-            delete mCustomPresent;
-            mCustomPresent = nullptr;
-        }
-        if (mCustomPresent && mCustomPresent->IsInitialized()) {
-            mCustomPresent->CalculateRenderTargetSize(InOutSizeX, InOutSizeY);
+        if (mCustomPresent->GetRenderTargetSize(InOutSizeX, InOutSizeY)) {
+            HMDDescription.SetRenderTargetSize(FIntPoint(InOutSizeX, InOutSizeY));
+        } else {
+            // RenderManager isn't open (yet); size the target like last time so it doesn't have to be reallocated
+            const FIntPoint profileSize = HMDDescription.GetRenderTargetSize();
+            if (profileSize.X > 0 && profileSize.Y > 0) {
+                InOutSizeX = profileSize.X;
+                InOutSizeY = profileSize.Y;
+            }
         }
     }
 }
@@ -137,6 +246,11 @@ bool FOSVRHMD::NeedReAllocateViewportRenderTarget(const FViewport &viewport) {
         renderTargetSize.X = viewport.GetRenderTargetTexture()->GetSizeX();
         renderTargetSize.Y = viewport.GetRenderTargetTexture()->GetSizeY();
 
+        // the display opened after the target was allocated, so it isn't RenderManager's
+        if (mCustomPresent && mCustomPresent->NeedsRenderTarget(viewport.GetRenderTargetTexture())) {
+            return true;
+        }
+
         uint32 newSizeX = inSizeX, newSizeY = inSizeY;
         CalculateRenderTargetSize(viewport, newSizeX, newSizeY);
         if (newSizeX != renderTargetSize.X || newSizeY != renderTargetSize.Y) {
@@ -157,10 +271,7 @@ void FOSVRHMD::UpdateViewport(bool bUseSeparateRenderTarget, const FViewport& In
     }
 
     if (mCustomPresent && mCustomPresent->IsInitialized()) {
-        if (!mCustomPresent->UpdateViewport(InViewport, viewportRHI)) {
-            delete mCustomPresent;
-            mCustomPresent = nullptr;
-        }
+        mCustomPresent->UpdateViewport(InViewport, viewportRHI);
     }
 }
 
@@ -0,0 +1,68 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+/**
+* Single-writer, multiple-reader sequence lock.
+*
+* The writer bumps the sequence to an odd value, copies the value in and bumps
+* it back to even. Readers copy the value out and retry if the sequence was
+* odd or changed meanwhile, so they never block the writer and never see a
+* torn value. T must be trivially copyable, and small enough that a retry is cheap.
+*/
+template<typename T>
+class TOSVRSeqLock
+{
+public:
+    TOSVRSeqLock() :
+        Sequence(0)
+    {
+    }
+
+    /** Writer side. Only ever call from one thread. */
+    void Write(const T& InValue)
+    {
+        FPlatformAtomics::InterlockedIncrement(&Sequence);
+        Value = InValue;
+        FPlatformAtomics::InterlockedIncrement(&Sequence);
+    }
+
+    /** Reader side. May be called from any thread. */
+    T Read() const
+    {
+        T ret;
+        for (;;) {
+            const int32 before = Sequence;
+            if ((before & 1) == 0) {
+                FPlatformMisc::MemoryBarrier();
+                ret = Value;
+                FPlatformMisc::MemoryBarrier();
+                if (Sequence == before) {
+                    return ret;
+                }
+            }
+            FPlatformProcess::Sleep(0.0f);
+        }
+    }
+
+private:
+    TOSVRSeqLock(const TOSVRSeqLock&);
+    TOSVRSeqLock& operator=(const TOSVRSeqLock&);
+
+    T Value;
+    volatile int32 Sequence;
+};
@@ -0,0 +1,72 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+// "stat OSVR" in the console shows these. The lock stats count the time
+// spent waiting for a lock and holding it, per thread, so contention between
+// the game, tracking and render threads shows up as wait time on one of them.
+DECLARE_STATS_GROUP(TEXT("OSVR"), STATGROUP_OSVR, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Present"), STAT_OSVRPresent, STATGROUP_OSVR, OSVR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Client context lock wait"), STAT_OSVRContextLockWait, STATGROUP_OSVR, OSVR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Client context lock held"), STAT_OSVRContextLockHeld, STATGROUP_OSVR, OSVR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Present lifecycle lock wait"), STAT_OSVRPresentLockWait, STATGROUP_OSVR, OSVR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Present lifecycle lock held"), STAT_OSVRPresentLockHeld, STATGROUP_OSVR, OSVR_API);
+
+/**
+* Like FScopeLock, but counts the time spent waiting for the lock in WaitStatId
+* and the time it's held in HeldStatId.
+*/
+class FOSVRScopeLock
+{
+public:
+    FOSVRScopeLock(FCriticalSection* InMutex, TStatId WaitStatId, TStatId HeldStatId) :
+        Mutex(Lock(InMutex, WaitStatId)),
+        HeldCounter(HeldStatId)
+    {
+    }
+
+    ~FOSVRScopeLock()
+    {
+        Mutex->Unlock();
+    }
+
+private:
+    FOSVRScopeLock(const FOSVRScopeLock&);
+    FOSVRScopeLock& operator=(const FOSVRScopeLock&);
+
+    static FCriticalSection* Lock(FCriticalSection* InMutex, TStatId WaitStatId)
+    {
+        FScopeCycleCounter waitCounter(WaitStatId);
+        InMutex->Lock();
+        return InMutex;
+    }
+
+    FCriticalSection* Mutex;
+    FScopeCycleCounter HeldCounter;
+};
+
+/** FOSVRScopeLock on the client context mutex, see FOSVRClientContext::GetMutex. */
+class FOSVRContextScopeLock : public FOSVRScopeLock
+{
+public:
+    explicit FOSVRContextScopeLock(FCriticalSection* InMutex) :
+        FOSVRScopeLock(InMutex, GET_STATID(STAT_OSVRContextLockWait), GET_STATID(STAT_OSVRContextLockHeld))
+    {
+    }
+};
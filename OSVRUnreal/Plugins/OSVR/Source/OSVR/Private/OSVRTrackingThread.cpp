@@ -0,0 +1,178 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "OSVRPrivatePCH.h"
+#include "OSVRTrackingThread.h"
+#include "OSVRStats.h"
+
+DEFINE_LOG_CATEGORY(OSVRTrackingThreadLog);
+
+namespace {
+    TAutoConsoleVariable<int32> CVarOSVRTrackingThread(
+        TEXT("osvr.TrackingThread"),
+        0,
+        TEXT("1 to pump the OSVR client context on a dedicated tracking thread instead of the game thread.\n")
+        TEXT("osvr.LateLatching starts it too. Read when the HMD connects to the server."),
+        ECVF_Default);
+
+    TAutoConsoleVariable<float> CVarOSVRTrackingThreadRate(
+        TEXT("osvr.TrackingThreadRate"),
+        1000.0f,
+        TEXT("Rate, in Hz, at which the tracking thread updates the OSVR client context."),
+        ECVF_Default);
+}
+
+FOSVRTrackingThread::FOSVRTrackingThread(OSVR_ClientContext clientContext, FCriticalSection* clientContextMutex, OSVR_DisplayConfig displayConfig) :
+    ClientContext(clientContext),
+    ClientContextMutex(clientContextMutex),
+    DisplayConfig(displayConfig)
+{
+    check(ClientContextMutex);
+    for (int32 i = 0; i < TRACKED_PATH_COUNT; i++) {
+        Interfaces[i] = nullptr;
+    }
+}
+
+FOSVRTrackingThread::~FOSVRTrackingThread()
+{
+    Shutdown();
+    delete Thread;
+    Thread = nullptr;
+}
+
+void FOSVRTrackingThread::Shutdown()
+{
+    // Thread itself is left alone so IsRunning() stays safe to call from the
+    // render thread; StopCounter tells it the thread is gone
+    if (Thread && !bShutDown) {
+        bShutDown = true;
+        Thread->Kill(true);
+    }
+}
+
+bool FOSVRTrackingThread::IsEnabled()
+{
+    // late latching reads its poses from the tracking thread, so it needs one
+    static const IConsoleVariable* lateLatching = IConsoleManager::Get().FindConsoleVariable(TEXT("osvr.LateLatching"));
+    return CVarOSVRTrackingThread.GetValueOnGameThread() != 0 || (lateLatching && lateLatching->GetInt() != 0);
+}
+
+bool FOSVRTrackingThread::Start()
+{
+    check(!Thread);
+    Thread = FRunnableThread::Create(this, TEXT("OSVRTrackingThread"), 0, TPri_AboveNormal);
+    if (!Thread) {
+        UE_LOG(OSVRTrackingThreadLog, Warning, TEXT("Could not create the OSVR tracking thread. Falling back to game thread updates."));
+        return false;
+    }
+    return true;
+}
+
+bool FOSVRTrackingThread::Init()
+{
+    FScopeLock lock(ClientContextMutex);
+    for (int32 i = 0; i < TRACKED_PATH_COUNT; i++) {
+        const char* path = OSVRTrackedPathName(EOSVRTrackedPath(i));
+        if (osvrClientGetInterface(ClientContext, path, &Interfaces[i]) != OSVR_RETURN_SUCCESS) {
+            UE_LOG(OSVRTrackingThreadLog, Warning, TEXT("Could not get the %s interface."), ANSI_TO_TCHAR(path));
+            Interfaces[i] = nullptr;
+        }
+    }
+    return true;
+}
+
+uint32 FOSVRTrackingThread::Run()
+{
+    while (StopCounter.GetValue() == 0) {
+        const double iterationStart = FPlatformTime::Seconds();
+
+        auto& state = GameThreadBuffer.GetWriteBuffer();
+        Sample(state);
+        GameThreadBuffer.Publish();
+
+        RenderThreadBuffer.GetWriteBuffer() = state;
+        RenderThreadBuffer.Publish();
+
+        const float rate = FMath::Max(CVarOSVRTrackingThreadRate.GetValueOnAnyThread(), 1.0f);
+        const double remaining = (1.0 / rate) - (FPlatformTime::Seconds() - iterationStart);
+        if (remaining > 0.0) {
+            FPlatformProcess::Sleep(static_cast<float>(remaining));
+        }
+    }
+    return 0;
+}
+
+void FOSVRTrackingThread::Stop()
+{
+    StopCounter.Increment();
+}
+
+void FOSVRTrackingThread::Exit()
+{
+    FScopeLock lock(ClientContextMutex);
+    for (int32 i = 0; i < TRACKED_PATH_COUNT; i++) {
+        if (Interfaces[i]) {
+            osvrClientFreeInterface(ClientContext, Interfaces[i]);
+            Interfaces[i] = nullptr;
+        }
+    }
+}
+
+void FOSVRTrackingThread::Sample(FOSVRTrackingState& OutState)
+{
+    FOSVRContextScopeLock lock(ClientContextMutex);
+
+    if (osvrClientUpdate(ClientContext) == OSVR_RETURN_FAILURE && !bLoggedUpdateFailure) {
+        UE_LOG(OSVRTrackingThreadLog, Warning, TEXT("osvrClientUpdate failed on the tracking thread."));
+        bLoggedUpdateFailure = true;
+    }
+    osvrTimeValueGetNow(&OutState.SampleTime);
+
+    OutState.bViewerPoseValid = DisplayConfig &&
+        osvrClientGetViewerPose(DisplayConfig, 0, &OutState.ViewerPose) == OSVR_RETURN_SUCCESS;
+
+    for (int32 i = 0; i < TRACKED_PATH_COUNT; i++) {
+        OutState.bPoseValid[i] = Interfaces[i] &&
+            osvrGetPoseState(Interfaces[i], &OutState.PoseTimestamps[i], &OutState.Poses[i]) == OSVR_RETURN_SUCCESS;
+    }
+
+    if (FOSVRPoseFilterBank::IsEnabled()) {
+        // the head lane filters the viewer pose, which is what the HMD uses
+        const bool bFilterHead = OutState.bViewerPoseValid && FOSVRPoseFilterBank::IsEnabled(TRACKED_PATH_HEAD);
+        PoseFilter.SetParams(FOSVRPoseFilterParams::FromConsoleVariables());
+        if (bFilterHead) {
+            const OSVR_TimeValue& timestamp = OutState.bPoseValid[TRACKED_PATH_HEAD] ? OutState.PoseTimestamps[TRACKED_PATH_HEAD] : OutState.SampleTime;
+            PoseFilter.AddSample(TRACKED_PATH_HEAD, timestamp, OutState.ViewerPose);
+        }
+        for (int32 i = TRACKED_PATH_HEAD + 1; i < TRACKED_PATH_COUNT; i++) {
+            if (OutState.bPoseValid[i]) {
+                PoseFilter.AddSample(EOSVRTrackedPath(i), OutState.PoseTimestamps[i], OutState.Poses[i]);
+            }
+        }
+        PoseFilter.Filter();
+
+        if (bFilterHead) {
+            PoseFilter.GetFilteredPose(TRACKED_PATH_HEAD, OutState.ViewerPose);
+        }
+        for (int32 i = TRACKED_PATH_HEAD + 1; i < TRACKED_PATH_COUNT; i++) {
+            if (OutState.bPoseValid[i]) {
+                PoseFilter.GetFilteredPose(EOSVRTrackedPath(i), OutState.Poses[i]);
+            }
+        }
+    }
+
+    OutState.Sequence = ++Sequence;
+}
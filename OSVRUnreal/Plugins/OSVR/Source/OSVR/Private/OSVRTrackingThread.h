@@ -0,0 +1,118 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include "OSVRTypes.h"
+#include "OSVRTripleBuffer.h"
+#include "OSVRPoseFilter.h"
+
+#include <osvr/ClientKit/DisplayC.h>
+#include <osvr/Util/TimeValueC.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(OSVRTrackingThreadLog, Log, All);
+
+/** Everything the tracking thread samples in one iteration. */
+struct FOSVRTrackingState
+{
+    /** Incremented on every publish. Zero means nothing has been published yet. */
+    uint64 Sequence = 0;
+
+    /** Local OSVR time at which this state was sampled */
+    OSVR_TimeValue SampleTime = { 0, 0 };
+
+    bool bViewerPoseValid = false;
+    OSVR_Pose3 ViewerPose;
+
+    bool bPoseValid[TRACKED_PATH_COUNT] = {};
+    OSVR_PoseState Poses[TRACKED_PATH_COUNT];
+    OSVR_TimeValue PoseTimestamps[TRACKED_PATH_COUNT];
+};
+
+/**
+* Optional thread that pumps the shared client context at a fixed rate and
+* publishes the viewer and interface poses. The game thread and the render
+* thread each read their own triple buffer, so neither ever takes a lock to
+* get at a pose, and a game-thread hitch no longer delays tracker reports.
+*
+* Enabled with osvr.TrackingThread=1, or by osvr.LateLatching, rate set by
+* osvr.TrackingThreadRate.
+*/
+class FOSVRTrackingThread : public FRunnable
+{
+public:
+    FOSVRTrackingThread(OSVR_ClientContext clientContext, FCriticalSection* clientContextMutex, OSVR_DisplayConfig displayConfig);
+    virtual ~FOSVRTrackingThread();
+
+    /** @return True if the tracking thread is enabled in the config, or late latching needs it. */
+    static bool IsEnabled();
+
+    /** Starts the thread. @return false if it could not be created. */
+    bool Start();
+
+    /**
+    * Stops the thread and waits for it to exit. Game thread only. The
+    * published state stays readable until the object is destroyed.
+    */
+    void Shutdown();
+
+    /** FRunnable interface */
+    virtual bool Init() override;
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+    virtual void Exit() override;
+
+    /**
+    * Copies the most recently published state. May be called from the game
+    * thread or the render thread, each of which has its own buffer.
+    *
+    * @return False if the thread hasn't published anything yet.
+    */
+    bool GetLatestState(FOSVRTrackingState& OutState)
+    {
+        check(IsInGameThread() || IsInRenderingThread());
+        auto& buffer = IsInGameThread() ? GameThreadBuffer : RenderThreadBuffer;
+        buffer.Acquire();
+        OutState = buffer.GetReadBuffer();
+        return OutState.Sequence != 0;
+    }
+
+    /** @return True between a successful Start() and the thread exiting. */
+    bool IsRunning() const
+    {
+        return Thread != nullptr && StopCounter.GetValue() == 0;
+    }
+
+private:
+    void Sample(FOSVRTrackingState& OutState);
+
+    OSVR_ClientContext ClientContext;
+    FCriticalSection* ClientContextMutex;
+    OSVR_DisplayConfig DisplayConfig;
+    OSVR_ClientInterface Interfaces[TRACKED_PATH_COUNT];
+
+    FRunnableThread* Thread = nullptr;
+    bool bShutDown = false;
+    FThreadSafeCounter StopCounter;
+    uint64 Sequence = 0;
+    bool bLoggedUpdateFailure = false;
+
+    /** Filters all paths at once after each sample, see osvr.PoseFilter */
+    FOSVRPoseFilterBank PoseFilter;
+
+    TOSVRTripleBuffer<FOSVRTrackingState> GameThreadBuffer;
+    TOSVRTripleBuffer<FOSVRTrackingState> RenderThreadBuffer;
+};
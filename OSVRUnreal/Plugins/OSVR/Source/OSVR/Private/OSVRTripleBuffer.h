@@ -0,0 +1,87 @@
+//
+// Copyright 2016 Sensics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+/**
+* Wait-free single-producer, single-consumer triple buffer.
+*
+* The producer always owns one slot and the consumer always owns another. The
+* third slot is exchanged between them with a single atomic swap, so neither
+* side ever blocks and the consumer always sees the most recently published value.
+*/
+template<typename T>
+class TOSVRTripleBuffer
+{
+public:
+    TOSVRTripleBuffer() :
+        WriteIndex(0),
+        SharedIndex(1),
+        ReadIndex(2)
+    {
+    }
+
+    /** Producer side: the slot to fill in before calling Publish(). */
+    T& GetWriteBuffer()
+    {
+        return Buffers[WriteIndex];
+    }
+
+    /** Producer side: makes the write slot visible to the consumer. */
+    void Publish()
+    {
+        FPlatformMisc::MemoryBarrier();
+        WriteIndex = FPlatformAtomics::InterlockedExchange(&SharedIndex, WriteIndex | DirtyBit) & IndexMask;
+    }
+
+    /**
+    * Consumer side: takes ownership of the most recently published slot, if
+    * anything was published since the last call.
+    *
+    * @return True if the read slot changed.
+    */
+    bool Acquire()
+    {
+        if ((SharedIndex & DirtyBit) == 0) {
+            return false;
+        }
+        ReadIndex = FPlatformAtomics::InterlockedExchange(&SharedIndex, ReadIndex) & IndexMask;
+        FPlatformMisc::MemoryBarrier();
+        return true;
+    }
+
+    /** Consumer side: the slot taken by the last successful Acquire(). */
+    const T& GetReadBuffer() const
+    {
+        return Buffers[ReadIndex];
+    }
+
+private:
+    enum
+    {
+        IndexMask = 0x3,
+        DirtyBit = 0x4
+    };
+
+    TOSVRTripleBuffer(const TOSVRTripleBuffer&);
+    TOSVRTripleBuffer& operator=(const TOSVRTripleBuffer&);
+
+    T Buffers[3];
+
+    int32 WriteIndex;
+    volatile int32 SharedIndex;
+    int32 ReadIndex;
+};
@@ -16,6 +16,27 @@
 
 #pragma once
 
+#include <osvr/Util/TimeValueC.h>
+
+// The pose interfaces the plugin tracks besides the viewer itself.
+enum EOSVRTrackedPath
+{
+    TRACKED_PATH_HEAD = 0,
+    TRACKED_PATH_LEFT_HAND,
+    TRACKED_PATH_RIGHT_HAND,
+    TRACKED_PATH_COUNT
+};
+
+FORCEINLINE const char* OSVRTrackedPathName(EOSVRTrackedPath Path)
+{
+    static const char* Names[TRACKED_PATH_COUNT] = {
+        "/me/head",
+        "/me/hands/left",
+        "/me/hands/right"
+    };
+    return Names[Path];
+}
+
 FORCEINLINE FVector OSVR2FVector(const OSVR_Vec3& Vec3)
 {
 	// OSVR: The coordinate system is right-handed, with X to the right, Y up, and Z near.
@@ -23,6 +44,16 @@ FORCEINLINE FVector OSVR2FVector(const OSVR_Vec3& Vec3)
 	return FVector(-float(Vec3.data[2]), float(Vec3.data[0]), float(Vec3.data[1]));
 }
 
+// Inverse of OSVR2FVector
+FORCEINLINE OSVR_Vec3 FVector2OSVR(const FVector& Vec)
+{
+    OSVR_Vec3 ret;
+    ret.data[0] = Vec.Y;
+    ret.data[1] = Vec.Z;
+    ret.data[2] = -Vec.X;
+    return ret;
+}
+
 FORCEINLINE FQuat OSVR2FQuat(const OSVR_Quaternion& Quat)
 {
 	//UE_LOG(LogActor, Warning, TEXT("X=%3.3f Y=%3.3f Z=%3.3f W=%3.3f"), osvrQuatGetX(&Quat), osvrQuatGetY(&Quat), osvrQuatGetZ(&Quat), osvrQuatGetW(&Quat));
@@ -32,6 +63,27 @@ FORCEINLINE FQuat OSVR2FQuat(const OSVR_Quaternion& Quat)
 	return q;
 }
 
+// Inverse of OSVR2FQuat
+FORCEINLINE OSVR_Quaternion FQuat2OSVR(const FQuat& Quat)
+{
+    OSVR_Quaternion ret;
+    osvrQuatSetX(&ret, Quat.Y);
+    osvrQuatSetY(&ret, Quat.Z);
+    osvrQuatSetZ(&ret, -Quat.X);
+    osvrQuatSetW(&ret, -Quat.W);
+    return ret;
+}
+
+FORCEINLINE OSVR_TimeValue OSVRTimeValueAddSeconds(const OSVR_TimeValue& TimeValue, double Seconds)
+{
+    OSVR_TimeValue ret = TimeValue;
+    const double wholeSeconds = FMath::FloorToDouble(Seconds);
+    ret.seconds += static_cast<OSVR_TimeValue_Seconds>(wholeSeconds);
+    ret.microseconds += static_cast<OSVR_TimeValue_Microseconds>((Seconds - wholeSeconds) * 1000000.0);
+    osvrTimeValueNormalize(&ret);
+    return ret;
+}
+
 // Assumes row-major, left-handed matrix
 FORCEINLINE FMatrix OSVR2FMatrix(const float in[16]) {
     return FMatrix(
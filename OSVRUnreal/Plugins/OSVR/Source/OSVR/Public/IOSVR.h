@@ -9,6 +9,9 @@
 
 class OSVREntryPoint;
 class FOSVRHMD;
+class FOSVRTrackingThread;
+class FOSVRClockSync;
+class FOSVRClientContext;
 
 /**
 * The public interface to this module.  In most cases, this interface is only public to sibling modules
@@ -45,8 +48,46 @@ public:
     }
 
     virtual void LoadOSVRClientKitModule() = 0;
+
+    /**
+    * Loads RenderManager and its dependencies, which module startup leaves out.
+    * Call before the first RenderManager call.
+    *
+    * @return True if the libraries are loaded.
+    */
+    virtual bool LoadRenderManagerModule() = 0;
     virtual OSVREntryPoint* GetEntryPoint() = 0;
     virtual TSharedPtr<FOSVRHMD, ESPMode::ThreadSafe> GetHMD() = 0;
+
+    /**
+    * @return The tracking thread, or nullptr if poses are updated on the game
+    * thread. Takes no lock. The pointer stays valid until the end of the
+    * current game thread tick, or on the render thread, of the current render
+    * command; don't keep it any longer.
+    */
+    virtual FOSVRTrackingThread* GetTrackingThread() = 0;
+
+    /**
+    * Starts the tracking thread if it's enabled and not running yet. Called by
+    * the HMD once its display config is up.
+    */
+    virtual void StartTrackingThread() = 0;
+
+    /**
+    * Stops the tracking thread if it's running, e.g. while the HMD swaps its
+    * display config. Waits for it to exit, so it no longer samples the
+    * handles it was started with once this returns.
+    */
+    virtual void StopTrackingThread() = 0;
+
+    /** @return The service relating OSVR timestamps to FPlatformTime cycles. Valid while the module is loaded. */
+    virtual FOSVRClockSync* GetClockSync() = 0;
+
+    /**
+    * @return The client context shared by everything in the plugin. Register
+    * with it before using the context, and keep the pointer until unregistered.
+    */
+    virtual TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> GetClientContext() = 0;
 };
 
 DECLARE_LOG_CATEGORY_EXTERN(OSVRLog, Log, All);
@@ -51,5 +51,29 @@ public class OSVRClientKit : ModuleRules
                 RuntimeDependencies.Add(new RuntimeDependency(src));
             }
         }
+        else if (Target.Platform == UnrealTargetPlatform.Linux)
+        {
+            string baseBinaryDirectory = ModuleDirectory + "/bin";
+            if (!System.IO.Directory.Exists(baseBinaryDirectory))
+            {
+                baseBinaryDirectory = "$(EngineDir)/Binaries/ThirdParty/OSVRClientKit/bin";
+            }
+            string linuxBinaryDirectory = baseBinaryDirectory + "/Linux";
+
+            // Linked directly, RenderManager included: there's no delay-loading
+            // here, so the OSVR module's RenderManager calls need it to resolve.
+            var osvrClientKitLibs = new string[] {
+                "libosvrUtil.so",
+                "libosvrCommon.so",
+                "libosvrClient.so",
+                "libosvrClientKit.so",
+                "libosvrRenderManager.so"
+            };
+            foreach (var lib in osvrClientKitLibs)
+            {
+                PublicAdditionalLibraries.Add(String.Format("{0}/{1}", linuxBinaryDirectory, lib));
+                RuntimeDependencies.Add(new RuntimeDependency(String.Format("{0}/{1}", linuxBinaryDirectory, lib)));
+            }
+        }
     }
 }
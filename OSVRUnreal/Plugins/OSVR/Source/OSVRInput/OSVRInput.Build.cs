@@ -50,5 +50,17 @@ public class OSVRInput : ModuleRules
                             Path.Combine(EngineDir, @"Source\Runtime\Windows\D3D11RHI\Private\Windows")
                             });
         }
+        else if (Target.Platform == UnrealTargetPlatform.Linux)
+        {
+            // OSVRHMD.h pulls in the OpenGL custom present.
+            PrivateDependencyModuleNames.AddRange(new string[] { "OpenGLDrv" });
+            AddEngineThirdPartyPrivateStaticDependencies(Target, "OpenGL");
+
+            var EngineDir = Path.GetFullPath(BuildConfiguration.RelativeEnginePath);
+            PrivateIncludePaths.AddRange(
+                new string[] {
+                            Path.Combine(EngineDir, "Source/Runtime/OpenGLDrv/Private")
+                            });
+        }
     }
 }
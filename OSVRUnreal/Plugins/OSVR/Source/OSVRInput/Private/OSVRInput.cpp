@@ -22,6 +22,15 @@ IMPLEMENT_MODULE(FOSVRInput, OSVRInput)
 
 TSharedPtr< class IInputDevice > FOSVRInput::CreateInputDevice(const TSharedRef< FGenericApplicationMessageHandler >& InMessageHandler)
 {
+	// Keep the device, and with it the interfaces and the callbacks registered
+	// on them, when asked again (e.g. for another Play-In-Editor session).
+	// ClientKit can't unregister callbacks, so interfaces can't be shared instead.
+	if (InputDevice.IsValid())
+	{
+		InputDevice->SetMessageHandler(InMessageHandler);
+		return InputDevice;
+	}
+
 	FOSVRInputDevice::RegisterNewKeys();
 
 	InputDevice = MakeShareable(new FOSVRInputDevice(InMessageHandler));
@@ -18,12 +18,14 @@
 
 #include "GenericPlatformMath.h"
 #include "OSVREntryPoint.h"
+#include "OSVRClientContext.h"
 #include "OSVRInputDevice.h"
 #include "SlateBasics.h"
 #include "GenericApplicationMessageHandler.h"
 #include "OSVRTypes.h"
 #include "IOSVR.h"
 #include "OSVRHMD.h"
+#include "OSVRTrackingThread.h"
 
 #include <osvr/ClientKit/InterfaceStateC.h>
 
@@ -53,6 +55,8 @@ public:
 
     bool oldState = false;
     bool isValid = true;
+    // guards the state queues, which are filled from whichever thread pumps the context
+    FCriticalSection* stateQueueMutex = nullptr;
     float threshold = 0.75f;
     FName key;
     std::string ifacePath;
@@ -72,11 +76,13 @@ namespace {
 
     void buttonCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_ButtonReport *report) {
         OSVRButton* button = static_cast<OSVRButton*>(userdata);
+        FScopeLock lock(button->stateQueueMutex);
         button->digitalStateQueue.push(report->state == OSVR_BUTTON_PRESSED);
     }
 
     void analogCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_AnalogReport *report) {
         OSVRButton* button = static_cast<OSVRButton*>(userdata);
+        FScopeLock lock(button->stateQueueMutex);
         if (button->type == OSVR_BUTTON_TYPE_THRESHOLD) {
             bool newState = (button->thresholdType == OSVR_THRESHOLD_TYPE_GT && report->state > button->threshold) ||
                 (button->thresholdType == OSVR_THRESHOLD_TYPE_LT && report->state < button->threshold);
@@ -100,8 +106,11 @@ FOSVRInputDevice::FOSVRInputDevice(const TSharedRef< FGenericApplicationMessageH
     : MessageHandler(InMessageHandler)
 {
     // make sure OSVR module is loaded.
-    context = IOSVR::Get().GetEntryPoint()->GetClientContext();
+    clientContext = IOSVR::Get().GetClientContext();
+    context = clientContext->Register(TEXT("FOSVRInputDevice"), this);
 
+    // the tracking thread may already be pumping the context
+    FOSVRContextScopeLock lock(&clientContext->GetMutex());
     contextValid = context && osvrClientCheckStatus(context) == OSVR_RETURN_SUCCESS;
 
     if (contextValid) {
@@ -181,6 +190,7 @@ FOSVRInputDevice::FOSVRInputDevice(const TSharedRef< FGenericApplicationMessageH
 
         for (size_t i = 0; i < osvrButtons.size(); i++) {
             auto& button = osvrButtons[i];
+            button.stateQueueMutex = &stateQueueMutex;
 
             auto ifaceItr = interfaces.find(button.ifacePath);
             OSVR_ClientInterface iface = nullptr;
@@ -227,20 +237,94 @@ FOSVRInputDevice::FOSVRInputDevice(const TSharedRef< FGenericApplicationMessageH
 FOSVRInputDevice::~FOSVRInputDevice()
 {
     //GEngine->MotionControllerDevices.Remove(this); // This crashes. Maybe they changed something in the engine since the steamvr plugin was written?
-    if (context) {
-        if (leftHand) {
-            osvrClientFreeInterface(context, leftHand);
+    if (context && contextValid) {
+        FOSVRContextScopeLock lock(&clientContext->GetMutex());
+        freeInterfaces(context, interfaces, leftHand, rightHand);
+    }
+    clientContext->Unregister(TEXT("FOSVRInputDevice"), this);
+}
+
+void FOSVRInputDevice::freeInterfaces(OSVR_ClientContext ctx, std::map<std::string, OSVR_ClientInterface>& ifaces, OSVR_ClientInterface& left, OSVR_ClientInterface& right)
+{
+    if (left) {
+        osvrClientFreeInterface(ctx, left);
+        left = nullptr;
+    }
+    if (right) {
+        osvrClientFreeInterface(ctx, right);
+        right = nullptr;
+    }
+    for (auto iface : ifaces)
+    {
+        if (iface.second) {
+            osvrClientFreeInterface(ctx, iface.second);
         }
-        if (rightHand) {
-            osvrClientFreeInterface(context, rightHand);
+    }
+    ifaces.clear();
+}
+
+bool FOSVRInputDevice::PrepareReconnect(OSVR_ClientContext NewContext)
+{
+    if (!contextValid) {
+        // never got any interfaces to move over
+        return true;
+    }
+
+    // The buttons keep their state; their callbacks are registered again on
+    // the new interfaces. A button the new server doesn't have stays quiet.
+    for (size_t i = 0; i < osvrButtons.size(); i++) {
+        auto& button = osvrButtons[i];
+        if (!button.isValid) {
+            continue;
+        }
+        auto ifaceItr = pendingInterfaces.find(button.ifacePath);
+        OSVR_ClientInterface iface = nullptr;
+        if (ifaceItr == pendingInterfaces.end()) {
+            if (osvrClientGetInterface(NewContext, button.ifacePath.c_str(), &iface) != OSVR_RETURN_SUCCESS) {
+                iface = nullptr;
+            }
+            pendingInterfaces[button.ifacePath] = iface;
+        } else {
+            iface = ifaceItr->second;
         }
-        for (auto iface : interfaces)
-        {
-            if (iface.second) {
-                osvrClientFreeInterface(context, iface.second);
+
+        if (iface) {
+            if (button.type == OSVR_BUTTON_TYPE_DIGITAL) {
+                osvrRegisterButtonCallback(iface, buttonCallback, &button);
+            } else {
+                osvrRegisterAnalogCallback(iface, analogCallback, &button);
             }
         }
     }
+
+    if (osvrClientGetInterface(NewContext, "/me/hands/left", &pendingLeftHand) != OSVR_RETURN_SUCCESS) {
+        pendingLeftHand = nullptr;
+    }
+    if (osvrClientGetInterface(NewContext, "/me/hands/right", &pendingRightHand) != OSVR_RETURN_SUCCESS) {
+        pendingRightHand = nullptr;
+    }
+    return true;
+}
+
+void FOSVRInputDevice::CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext)
+{
+    if (!contextValid) {
+        return;
+    }
+    freeInterfaces(OldContext, interfaces, leftHand, rightHand);
+    interfaces.swap(pendingInterfaces);
+    leftHand = pendingLeftHand;
+    rightHand = pendingRightHand;
+    leftHandValid = leftHand != nullptr;
+    rightHandValid = rightHand != nullptr;
+    pendingLeftHand = nullptr;
+    pendingRightHand = nullptr;
+    context = NewContext;
+}
+
+void FOSVRInputDevice::AbortReconnect(OSVR_ClientContext NewContext)
+{
+    freeInterfaces(NewContext, pendingInterfaces, pendingLeftHand, pendingRightHand);
 }
 
 void FOSVRInputDevice::EventReport(const FKey& Key, const FVector& Translation, const FQuat& Orientation)
@@ -260,21 +344,49 @@ bool FOSVRInputDevice::GetControllerOrientationAndPosition(const int32 Controlle
 {
     bool RetVal = false;
     if (ControllerIndex == 0) {
-        if (osvrClientCheckStatus(context) == OSVR_RETURN_SUCCESS) {
+        OSVR_PoseState state;
+        const EOSVRTrackedPath path = DeviceHand == EControllerHand::Left ? TRACKED_PATH_LEFT_HAND : TRACKED_PATH_RIGHT_HAND;
+        FOSVRTrackingThread* trackingThread = IOSVR::Get().GetTrackingThread();
+        if (trackingThread) {
+            FOSVRTrackingState trackingState;
+            if (trackingThread->GetLatestState(trackingState) && trackingState.bPoseValid[path]) {
+                state = trackingState.Poses[path];
+                RetVal = true;
+            }
+        } else if (clientContext->IsConnected()) {
+            // also called from the render thread for late updates, and the
+            // hand interfaces are swapped under the mutex when reconnecting
+            FOSVRContextScopeLock lock(&clientContext->GetMutex());
             auto iface = DeviceHand == EControllerHand::Left ? leftHand : rightHand;
-            OSVR_PoseState state;
             OSVR_TimeValue tvalue;
-            if (osvrGetPoseState(iface, &tvalue, &state) == OSVR_RETURN_SUCCESS) {
-                float worldToMetersScale = IOSVR::Get().GetHMD()->GetWorldToMetersScale();
-                OutPosition = OSVR2FVector(state.translation) * worldToMetersScale;
-                OutOrientation = OSVR2FQuat(state.rotation).Rotator();
-                RetVal = true;
+            RetVal = osvrGetPoseState(iface, &tvalue, &state) == OSVR_RETURN_SUCCESS;
+            if (RetVal) {
+                IOSVR::Get().GetEntryPoint()->FilterPose(path, tvalue, state);
             }
         }
+
+        if (RetVal) {
+            float worldToMetersScale = IOSVR::Get().GetHMD()->GetWorldToMetersScale();
+            OutPosition = OSVR2FVector(state.translation) * worldToMetersScale;
+            OutOrientation = OSVR2FQuat(state.rotation).Rotator();
+        }
     }
     return RetVal;
 }
 
+bool FOSVRInputDevice::GetControllerOrientationAndPositionAtTime(const EControllerHand DeviceHand, const OSVR_TimeValue& Time, FRotator& OutOrientation, FVector& OutPosition) const
+{
+    const EOSVRTrackedPath path = DeviceHand == EControllerHand::Left ? TRACKED_PATH_LEFT_HAND : TRACKED_PATH_RIGHT_HAND;
+    FQuat orientation;
+    FVector position;
+    if (!IOSVR::Get().GetEntryPoint()->GetPoseAtTime(path, Time, orientation, position)) {
+        return false;
+    }
+    OutPosition = position * IOSVR::Get().GetHMD()->GetWorldToMetersScale();
+    OutOrientation = orientation.Rotator();
+    return true;
+}
+
 #if OSVR_UNREAL_3_11
 ETrackingStatus FOSVRInputDevice::GetControllerTrackingStatus(const int32, const EControllerHand) const
 {
@@ -287,13 +399,13 @@ ETrackingStatus FOSVRInputDevice::GetControllerTrackingStatus(const int32, const
 
 void FOSVRInputDevice::Tick(float DeltaTime)
 {
-    if (osvrClientCheckStatus(context) == OSVR_RETURN_SUCCESS) {
-        osvrClientUpdate(context);
-    }
+    // shared with the HMD and the entry point, only pumps once per frame
+    clientContext->Update();
 }
 
 void FOSVRInputDevice::SendControllerEvents()
 {
+    FScopeLock lock(&stateQueueMutex);
     const int32 controllerId = 0;
     for (size_t i = 0; i < osvrButtons.size(); i++) {
         auto& button = osvrButtons[i];
@@ -20,6 +20,7 @@
 #include "IInputDevice.h"
 #include "IMotionController.h"
 #include "IOSVR.h"
+#include "OSVRClientContext.h"
 #include "OSVRTypes.h"
 
 #include <osvr/ClientKit/InterfaceC.h>
@@ -37,7 +38,7 @@ class OSVRButton;
 /**
 *
 */
-class FOSVRInputDevice : public IInputDevice, public IMotionController
+class FOSVRInputDevice : public IInputDevice, public IMotionController, public IOSVRClientContextListener
 {
 public:
     FOSVRInputDevice(const TSharedRef< FGenericApplicationMessageHandler >& MessageHandler);
@@ -57,6 +58,14 @@ public:
     */
     virtual bool GetControllerOrientationAndPosition(const int32 ControllerIndex, const EControllerHand DeviceHand, FRotator& OutOrientation, FVector& OutPosition) const override;
 
+    /**
+    * Like GetControllerOrientationAndPosition, but at an arbitrary OSVR time,
+    * interpolated from the pose report history of the requested hand.
+    *
+    * @return					False if Time is older than the retained history
+    */
+    bool GetControllerOrientationAndPositionAtTime(const EControllerHand DeviceHand, const OSVR_TimeValue& Time, FRotator& OutOrientation, FVector& OutPosition) const;
+
 #if OSVR_UNREAL_3_11
     virtual ETrackingStatus GetControllerTrackingStatus(const int32, const EControllerHand) const override;
 #endif
@@ -79,14 +88,28 @@ public:
 
     void EventReport(const FKey& Key, const FVector& Translation, const FQuat& Orientation);
 
+    /** IOSVRClientContextListener: moves the button and hand interfaces over to a new context */
+    virtual bool PrepareReconnect(OSVR_ClientContext NewContext) override;
+    virtual void CommitReconnect(OSVR_ClientContext OldContext, OSVR_ClientContext NewContext) override;
+    virtual void AbortReconnect(OSVR_ClientContext NewContext) override;
+
 private:
     std::map<std::string, OSVR_ClientInterface> interfaces;
     std::vector<OSVRButton> osvrButtons;
+    TSharedPtr<FOSVRClientContext, ESPMode::ThreadSafe> clientContext;
     OSVR_ClientContext context;
     TSharedRef< FGenericApplicationMessageHandler > MessageHandler;
-    OSVR_ClientInterface leftHand;
-    OSVR_ClientInterface rightHand;
+    OSVR_ClientInterface leftHand = nullptr;
+    OSVR_ClientInterface rightHand = nullptr;
     bool leftHandValid = false;
     bool rightHandValid = false;
     bool contextValid = false;
+
+    /** From the context being reconnected to, see PrepareReconnect */
+    std::map<std::string, OSVR_ClientInterface> pendingInterfaces;
+    OSVR_ClientInterface pendingLeftHand = nullptr;
+    OSVR_ClientInterface pendingRightHand = nullptr;
+
+    void freeInterfaces(OSVR_ClientContext ctx, std::map<std::string, OSVR_ClientInterface>& ifaces, OSVR_ClientInterface& left, OSVR_ClientInterface& right);
+    FCriticalSection stateQueueMutex;
 };